@@ -5,6 +5,10 @@
 
 
 
+#define _DEFAULT_SOURCE
+
+
+
 /*============================ Including headers ============================*/
 
 
@@ -13,10 +17,384 @@
 #include "../libs/others.h"
 #include "../libs/logging.h"
 #include "../libs/text_edit.h"
+#include "../libs/hash.h"
 
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+
+
+
+
+/*======================== Macros & static functions ========================*/
+
+
+/*
+ * Set error of compilation and print it unless state is quiet.
+ */
+static void report_error (assembler_state_t state, proc_error_t error,
+                          const char* str)
+{
+	state->error = error;
+	if (!state->quiet)
+		print_error(error, str);
+}
+
+
+/*
+ * Grow array geometrically until it can hold need elements.
+ *
+ * @return array which may be moved or NULL if it can't be grown.
+ */
+static void* reserve (void* array, size_t* capacity, size_t need,
+                      size_t elem_size)
+{
+	if (need <= *capacity)
+		return array;
+
+	size_t new_capacity = *capacity ? *capacity : LABELS_INIT_CAPACITY;
+	while (new_capacity < need)
+		new_capacity *= 2;
+
+	void* new_ptr = realloc(array, new_capacity * elem_size);
+	if (new_ptr)
+		*capacity = new_capacity;
+
+	return new_ptr;
+}
+
+
+/*
+ * Make room for size bytes in output chunk. Full chunk is written into
+ * output file, chunk without file grows.
+ */
+static bool make_room (assembler_state_t state, size_t size)
+{
+	io_t* io = &state->io;
+	if (io->output_size + size <= io->output_capacity)
+		return true;
+
+	if (io->file && io->output_capacity >= OUTPUT_CHUNK_SIZE)
+	{
+		if (!flush_output(state))
+			return false;
+
+		if (size <= io->output_capacity)
+			return true;
+	}
+
+	char* output = (char*) reserve(io->output, &io->output_capacity,
+	                               io->output_size + size, 1);
+	if (!output)
+	{
+		report_error(state, ALLOC_ERR, "output");
+		return false;
+	}
+
+	io->output = output;
+	return true;
+}
+
+
+static bool write_block (FILE* file, const char* block, addr_t begin,
+                         size_t size)
+{
+	return size == 0 || (fseek(file, (long) begin, SEEK_SET) == 0
+	                     && fwrite(block, 1, size, file) == size);
+}
+
+
+/*
+ * Insert labels' addresses into output which is already written into file.
+ * Patches are sorted by place, so file is read and rewritten by blocks
+ * of OUTPUT_CHUNK_SIZE bytes instead of seeking for every patch.
+ */
+static bool patch_file (assembler_state_t state)
+{
+	const label_table_t* labels = &state->labels;
+	io_t*                io     = &state->io;
+
+	char*  block   = (char*) malloc(OUTPUT_CHUNK_SIZE);
+	addr_t begin   = 0;
+	size_t size    = 0;
+	bool   success = (block != NULL);
+
+	for (size_t i = 0; success && i < labels->patches_size; ++i)
+	{
+		label_patch_t patch = labels->patches[i];
+		if (patch.place >= io->flushed)
+			break;
+
+		if (patch.place + sizeof (addr_t) > begin + size)
+		{
+			success = write_block(io->file, block, begin, size);
+			begin   = patch.place;
+			size    = (io->flushed - begin < OUTPUT_CHUNK_SIZE)
+			          ? (size_t) (io->flushed - begin) : OUTPUT_CHUNK_SIZE;
+			success = success && fseek(io->file, (long) begin, SEEK_SET) == 0
+			          && fread(block, 1, size, io->file) == size;
+		}
+
+		if (success)
+			memcpy(block + (patch.place - begin),
+			       &labels->table[patch.label].address, sizeof (addr_t));
+	}
+
+	success = success && write_block(io->file, block, begin, size)
+	          && fseek(io->file, 0, SEEK_END) == 0;
+
+	free(block);
+	return success;
+}
+
+
+/*
+ * Find slot which contains label with given name or empty slot
+ * where it should be inserted.
+ */
+static size_t* find_slot (const label_table_t* labels, const char* name,
+                          size_t name_len, uint64_t hash)
+{
+	size_t mask = labels->slots_amount - 1;
+
+	for (size_t i = hash & mask; ; i = (i + 1) & mask)
+	{
+		size_t index = labels->slots[i];
+		if (index == 0)
+			return labels->slots + i;
+
+		const label_t* label = labels->table + index - 1;
+		if (label->hash == hash && label->name_len == name_len
+		    && memcmp(labels->names + label->name, name, name_len) == 0)
+			return labels->slots + i;
+	}
+}
+
+
+/*
+ * Double amount of slots and insert all labels again.
+ */
+static bool grow_slots (label_table_t* labels)
+{
+	size_t  amount = labels->slots_amount * 2;
+	size_t* slots  = (size_t*) calloc(amount, sizeof *slots);
+	if (!slots)
+		return false;
+
+	free(labels->slots);
+	labels->slots        = slots;
+	labels->slots_amount = amount;
+
+	/* names are unique, so only empty slot has to be found             */
+	size_t mask = amount - 1;
+	for (size_t i = 0; i < labels->size; ++i)
+	{
+		size_t slot = labels->table[i].hash & mask;
+		while (slots[slot])
+			slot = (slot + 1) & mask;
+
+		slots[slot] = i + 1;
+	}
+
+	return true;
+}
+
+
+static inline size_t mnemonic_hash (size_t multiplier, const char* name,
+                                    size_t name_len)
+{
+	size_t first = (unsigned char) name[0];
+	size_t last  = (unsigned char) name[name_len - 1];
+
+	return (first + multiplier * last + name_len) & (MNEMONIC_SLOTS - 1);
+}
+
+
+static inline bool is_blank (char c)
+{
+	return c == ' ' || (c >= '\t' && c <= '\r');
+}
+
+
+static inline bool is_letter (char c)
+{
+	return ('a' <= c && c <= 'z') || ('A' <= c && c <= 'Z');
+}
+
+
+static inline bool is_digit (char c)
+{
+	return '0' <= c && c <= '9';
+}
+
+
+/*
+ * Skip blanks and comments.
+ *
+ * @return false if the end of input is reached.
+ */
+static bool skip_blanks (assembler_state_t state)
+{
+	const char* input = state->io.input;
+	size_t      pos   = state->pos;
+
+	while (true)
+	{
+		if (is_blank(input[pos]))
+			++pos;
+		else if (input[pos] == ';')
+		{
+			while (input[pos] != '\n' && input[pos] != '\0')
+				++pos;
+		}
+		else
+			break;
+	}
+
+	state->pos = pos;
+	return input[pos] != '\0';
+}
+
+
+/*
+ * Read token which ends before blank or comment. Token of label's
+ * declaration also ends before colon.
+ */
+static token_t read_token (assembler_state_t state, bool stop_at_colon)
+{
+	const char* begin = state->io.input + state->pos;
+	const char* end   = begin;
+
+	while (*end != '\0' && !is_blank(*end) && *end != ';'
+	       && !(stop_at_colon && *end == ':'))
+		++end;
+
+	state->pos += (size_t) (end - begin);
+	return (token_t) { begin, (size_t) (end - begin) };
+}
+
+
+/*
+ * Print error with token which is cut to MAX_TOKEN_SIZE - 1 characters.
+ */
+static void token_error (assembler_state_t state, proc_error_t error,
+                         token_t token)
+{
+	char   str[MAX_TOKEN_SIZE] = {};
+	size_t len = (token.len < MAX_TOKEN_SIZE) ? token.len : MAX_TOKEN_SIZE - 1;
+
+	memcpy(str, token.begin, len);
+	report_error(state, error, str);
+}
+
+
+static void* compile_chunk (void* arg)
+{
+	assembler_state_t state = ((asm_chunk_t*) arg)->state;
+
+	while (state->error == NO_PROC_ERR && compile_next(state))
+		continue;
+
+	return NULL;
+}
+
+
+/*
+ * Insert addresses of labels from label's table of the whole file.
+ */
+static void* patch_chunk (void* arg)
+{
+	const asm_chunk_t*   chunk  = (const asm_chunk_t*) arg;
+	const label_table_t* labels = &chunk->state->labels;
+
+	for (size_t i = 0; i < labels->patches_size; ++i)
+	{
+		label_patch_t patch   = labels->patches[i];
+		addr_t        address = chunk->global->table[chunk->labels[patch.label]]
+		                        .address;
+
+		memcpy(chunk->state->io.output + patch.place, &address, sizeof address);
+	}
+
+	return NULL;
+}
+
+
+/*
+ * Run routine for every chunk in its own thread and wait for them.
+ * Chunk whose thread can't be started is processed by the caller.
+ */
+static void run_chunks (asm_chunk_t* chunks, size_t amount,
+                        void* (*routine) (void*))
+{
+	for (size_t i = 0; i < amount; ++i)
+		chunks[i].started = (pthread_create(&chunks[i].thread, NULL, routine,
+		                                    chunks + i) == 0);
+
+	for (size_t i = 0; i < amount; ++i)
+	{
+		if (chunks[i].started)
+			pthread_join(chunks[i].thread, NULL);
+		else
+			routine(chunks + i);
+	}
+}
+
+
+/*
+ * Merge labels of chunks into label's table of the whole file.
+ * Like in one pass, the last declaration of label wins.
+ *
+ * @return success of this operation.
+ */
+static bool merge_labels (assembler_state_t state, asm_chunk_t* chunks,
+                          size_t amount)
+{
+	for (size_t i = 0; i < amount; ++i)
+	{
+		const label_table_t* local = &chunks[i].state->labels;
+
+		chunks[i].global = &state->labels;
+		chunks[i].labels = (size_t*) malloc((local->size + 1)
+		                                    * sizeof *chunks[i].labels);
+		if (!chunks[i].labels)
+			return false;
+
+		for (size_t j = 0; j < local->size; ++j)
+		{
+			const label_t* label = local->table + j;
+			const char*    name  = local->names + label->name;
+
+			label_t* global = find_label(&state->labels, name, label->name_len);
+			if (!global)
+				global = create_label(state, name, label->name_len);
+
+			if (!global)
+				return false;
+
+			if (label->declared)
+			{
+				global->address  = chunks[i].base + label->address;
+				global->declared = true;
+			}
+
+			chunks[i].labels[j] = (size_t) (global - state->labels.table);
+		}
+	}
+
+	return true;
+}
+
+
+static void clear_labels (label_table_t* labels)
+{
+	memset(labels->slots, 0, labels->slots_amount * sizeof *labels->slots);
+	labels->size         = 0;
+	labels->names_size   = 0;
+	labels->patches_size = 0;
+}
 
 
 
@@ -40,7 +418,8 @@ FILE* create_executable (const char* fname)
 	strcpy(output_name, fname);
 	change_ext(output_name, EXEC_EXT);
 
-	return fopen(output_name, "wb");
+	/* written chunks of output are read back to insert labels' addresses */
+	return fopen(output_name, "w+b");
 }
 
 
@@ -52,12 +431,16 @@ void write_bytes (assembler_state_t state, const void* data, size_t size)
 	if_log (is_bad_mem(data, size), ERROR,
 		return;)
 
-	memcpy(state->io.output, data, size);
-	state->ip += size;
+	if (!make_room(state, size))
+		return;
+
+	memcpy(state->io.output + state->io.output_size, data, size);
+	state->io.output_size += size;
+	state->ip             += size;
 }
 
 
-assembler_state_t asm_state_init (FILE* in)
+assembler_state_t asm_state_init (FILE* in, FILE* out)
 {
 	if_log (is_bad_mem(in, sizeof *in), ERROR,
 		return NULL;)
@@ -66,56 +449,79 @@ assembler_state_t asm_state_init (FILE* in)
 	if (!state)
 		return NULL;
 
-	size_t in_size   = 0;
-	state->error     = NO_PROC_ERR;
-	state->io.input  = read_file(in, &in_size);
-	state->io.output = (char*) calloc(in_size, sizeof *state->io.output);
-	if (!state->io.input)
+	size_t in_size            = 0;
+	state->error              = NO_PROC_ERR;
+	state->io.input           = read_file(in, &in_size);
+	state->io.input_size      = in_size;
+	state->io.file            = out;
+	state->io.output_capacity = OUTPUT_INIT_CAPACITY;
+	state->io.output          = (char*) malloc(OUTPUT_INIT_CAPACITY);
+	if (!state->io.input || !state->io.output)
 		return asm_state_delete(state);
 
-	state->ip              = 0;
-	state->labels.size     = 0;
-	state->labels.capacity = 100;
-	state->labels.table    = (label_t*) calloc(sizeof *state->labels.table,
-	                                           state->labels.capacity);
-	if (!state->labels.table)
+	init_mnemonics(&state->mnemonics);
+
+	/* other arrays of label's table are allocated on the first use      */
+	state->ip                  = 0;
+	state->labels.slots_amount = LABELS_INIT_SLOTS;
+	state->labels.slots        = (size_t*) calloc(LABELS_INIT_SLOTS,
+	                                              sizeof *state->labels.slots);
+	if (!state->labels.slots)
 		return asm_state_delete(state);
 
 	return state;
 }
 
 
-assembler_state_t asm_state_delete (assembler_state_t state)
+assembler_state_t asm_chunk_init (char* input, size_t input_size)
 {
-	if_log (is_bad_mem(state, sizeof *state), WARNING,
+	if_log (is_bad_mem(input, input_size + 1), ERROR,
 		return NULL;)
 
-	free(state->io.input);
+	assembler_state_t state = (assembler_state_t) calloc(sizeof *state, 1);
+	if (!state)
+		return NULL;
 
-	for (size_t i = 0; i < state->labels.size; ++i)
-		free(state->labels.table[i].use);
+	state->error              = NO_PROC_ERR;
+	state->quiet              = true;
+	state->io.input           = input;
+	state->io.input_size      = input_size;
+	state->io.borrowed        = true;
+	state->io.file            = NULL;
+	state->io.output_capacity = OUTPUT_INIT_CAPACITY;
+	state->io.output          = (char*) malloc(OUTPUT_INIT_CAPACITY);
+	if (!state->io.output)
+		return asm_state_delete(state);
 
-	free(state->labels.table);
-	free(state);
+	init_mnemonics(&state->mnemonics);
 
-	return NULL;
+	state->ip                  = 0;
+	state->labels.slots_amount = LABELS_INIT_SLOTS;
+	state->labels.slots        = (size_t*) calloc(LABELS_INIT_SLOTS,
+	                                              sizeof *state->labels.slots);
+	if (!state->labels.slots)
+		return asm_state_delete(state);
+
+	return state;
 }
 
 
-void remove_comments (assembler_state_t state)
+assembler_state_t asm_state_delete (assembler_state_t state)
 {
-	if_log (is_bad_mem(state, sizeof *state), ERROR,
-		return;)
+	if_log (is_bad_mem(state, sizeof *state), WARNING,
+		return NULL;)
 
-	char* ptr = state->io.input;
+	if (!state->io.borrowed)
+		free(state->io.input);
+	free(state->io.output);
 
-	while ((ptr = strchr(ptr, ';')) != NULL)
-	{
-		char* endl = strchr(ptr, '\n');
-		if (!endl)
-			endl = ptr + strlen(ptr);
-		memset(ptr, '\n', endl - ptr);
-	}
+	free(state->labels.table);
+	free(state->labels.slots);
+	free(state->labels.names);
+	free(state->labels.patches);
+	free(state);
+
+	return NULL;
 }
 
 
@@ -134,107 +540,129 @@ bool insert_labels_addresses (assembler_state_t state)
 	if_log (is_bad_mem(state, sizeof *state), ERROR,
 		return false;)
 
-	for (size_t i = 0; i < state->labels.size; ++i)
+	const label_table_t* labels = &state->labels;
+
+	for (size_t i = 0; i < labels->size; ++i)
 	{
-		label_t label = state->labels.table[i];
-		if (label.address == 0)
+		if (!labels->table[i].declared)
 		{
-			state->error = UNKNOWN_LABEL;
-			print_error(UNKNOWN_LABEL, label.name);
+			report_error(state, UNKNOWN_LABEL,
+			             labels->names + labels->table[i].name);
 			return false;
 		}
+	}
 
-		for (size_t j = 0; j < label.use_amount; ++j)
-		{
-			state->io.output[label.use[j]] = label.address;
-		}
+	io_t* io = &state->io;
+	if (io->flushed && !patch_file(state))
+	{
+		report_error(state, WRITE_ERR, " Label's address.");
+		return false;
+	}
+
+	for (size_t i = 0; i < labels->patches_size; ++i)
+	{
+		label_patch_t patch = labels->patches[i];
+		if (patch.place >= io->flushed)
+			memcpy(io->output + (patch.place - io->flushed),
+			       &labels->table[patch.label].address, sizeof (addr_t));
 	}
+
 	return true;
 }
 
 
-bool increase_labels_capacity (assembler_state_t state)
+bool flush_output (assembler_state_t state)
 {
 	if_log (is_bad_mem(state, sizeof *state), ERROR,
 		return false;)
 
-	label_t* new_ptr = (label_t*) realloc(state->labels.table,
-			                              state->labels.capacity * 10
-			                              * sizeof *state->labels.table);
-		
-	if (!new_ptr)
+	io_t* io = &state->io;
+	if (fwrite(io->output, 1, io->output_size, io->file) != io->output_size)
 	{
-		state->error = ALLOC_ERR;
+		report_error(state, WRITE_ERR, " Assembler's output.");
 		return false;
 	}
-	state->labels.table = new_ptr;
-	state->labels.capacity *= 10;
 
+	io->flushed     += io->output_size;
+	io->output_size  = 0;
 	return true;
 }
 
 
-label_t* find_label (const label_table_t labels, const char* name)
+label_t* find_label (const label_table_t* labels, const char* name,
+                     size_t name_len)
 {
-	for (size_t i = 0; i < labels.size; ++i)
-	{
-		if (strncmp(labels.table[i].name, name, MAX_TOKEN_SIZE) == 0)
-			return labels.table + i;
-	}
+	if_log (is_bad_mem(labels, sizeof *labels), ERROR,
+		return NULL;)
 
-	return NULL;
+	uint64_t hash  = fnv1a_hash64(name, name_len);
+	size_t   index = *find_slot(labels, name, name_len, hash);
+
+	return index ? labels->table + index - 1 : NULL;
 }
 
 
-bool create_label (assembler_state_t state, const char* name)
+label_t* create_label (assembler_state_t state, const char* name,
+                       size_t name_len)
 {
 	if_log (is_bad_mem(state, sizeof *state), ERROR,
-		return false;)
+		return NULL;)
 
-	if_log (is_bad_byte_ptr(name), ERROR,
-		return false;)
+	label_table_t* labels = &state->labels;
 
-	label_t* label = state->labels.table + state->labels.size;
-	label->use_amount = 0;
-	label->capacity   = 1;
-	label->use        = NULL;
-	label->address    = 0;
-	strncpy(label->name, name, MAX_TOKEN_SIZE - 1);
-	return true;
+	/* load factor is kept not greater than 1/2                          */
+	if ((labels->size + 1) * 2 > labels->slots_amount && !grow_slots(labels))
+		return NULL;
+
+	label_t* table = (label_t*) reserve(labels->table, &labels->capacity,
+	                                    labels->size + 1, sizeof *table);
+	if (!table)
+		return NULL;
+	labels->table = table;
+
+	char* names = (char*) reserve(labels->names, &labels->names_capacity,
+	                              labels->names_size + name_len + 1, 1);
+	if (!names)
+		return NULL;
+	labels->names = names;
+
+	label_t* label  = labels->table + labels->size;
+	label->name     = labels->names_size;
+	label->name_len = name_len;
+	label->hash     = fnv1a_hash64(name, name_len);
+	label->address  = 0;
+	label->declared = false;
+
+	memcpy(labels->names + labels->names_size, name, name_len);
+	labels->names[labels->names_size + name_len] = '\0';
+	labels->names_size += name_len + 1;
+
+	*find_slot(labels, name, name_len, label->hash) = ++labels->size;
+	return label;
 }
 
 
-bool add_code_place (label_t* label, addr_t addr, proc_error_t* err)
+bool add_label_patch (label_table_t* labels, size_t label, addr_t place)
 {
-	if_log (is_bad_mem(label, sizeof *label), ERROR,
-		return false;)
-
-	if_log (is_bad_mem(err, sizeof *err), ERROR,
+	if_log (is_bad_mem(labels, sizeof *labels), ERROR,
 		return false;)
 
-	if (label->use_amount + 1 >= label->capacity)
-	{
-		addr_t* new_ptr = (addr_t*) realloc(label->use, label->capacity 
-		                                    * 10 * sizeof *label->use);
-
-		if (!new_ptr)
-		{
-			*err = ALLOC_ERR;
-			return false;
-		}
-		label->use = new_ptr;
-		label->capacity *= 10;
-	}
+	label_patch_t* patches = (label_patch_t*) reserve(labels->patches,
+	                                                  &labels->patches_capacity,
+	                                                  labels->patches_size + 1,
+	                                                  sizeof *patches);
+	if (!patches)
+		return false;
 
-	label->use[label->use_amount] = addr + 1;
-	++label->use_amount;
+	labels->patches = patches;
+	labels->patches[labels->patches_size++] = (label_patch_t) { label, place };
 
 	return true;
 }
 
 
 bool update_label (assembler_state_t state, const char* name,
-                   bool is_label_declaration)
+                   size_t name_len, bool is_label_declaration)
 {
 	if_log (is_bad_mem(state, sizeof *state), ERROR,
 		return false;)
@@ -242,80 +670,122 @@ bool update_label (assembler_state_t state, const char* name,
 	if_log (is_bad_byte_ptr(name), ERROR,
 		return false;)
 
-	label_t* label = find_label(state->labels, name);
+	label_t* label = find_label(&state->labels, name, name_len);
+	if (!label)
+		label = create_label(state, name, name_len);
+
 	if (!label)
 	{
-		size_t new_index = state->labels.size;
+		state->error = ALLOC_ERR;
+		return false;
+	}
 
-		if (new_index + 1 >= state->labels.capacity
-		    || !increase_labels_capacity(state))
-		{
-			state->error = ALLOC_ERR;
-			return false;
-		}
+	if (is_label_declaration)
+	{
+		label->address  = state->ip;
+		label->declared = true;
+		return true;
+	}
 
-		if (!create_label(state, name))
-			return false;
-		
-		if (is_label_declaration)
-		{
-			state->labels.table[new_index].address = state->ip;
-		}
-		else
+	/* address of label is written right at the current position         */
+	if (!add_label_patch(&state->labels, (size_t) (label - state->labels.table),
+	                     state->ip))
+	{
+		state->error = ALLOC_ERR;
+		return false;
+	}
+
+	return true;
+}
+
+
+void init_mnemonics (mnemonic_table_t* mnemonics)
+{
+	if_log (is_bad_mem(mnemonics, sizeof *mnemonics), ERROR,
+		return;)
+
+	/* odd multipliers are tried until all mnemonics get their own slots;
+	 * if there is no such one, collisions are resolved by probing       */
+	for (size_t multiplier = 1; multiplier < MNEMONIC_SLOTS * 2;
+	     multiplier += 2)
+	{
+		bool perfect = true;
+
+		memset(mnemonics->slots, 0, sizeof mnemonics->slots);
+		mnemonics->multiplier = multiplier;
+
+		for (size_t opcode = 0; opcode < CMD_AMOUNT; ++opcode)
 		{
-			if (!add_code_place(state->labels.table + new_index,
-			                    state->ip, &state->error))
+			const cmd_info_t* cmd = CMD_INFO + opcode;
+			if (!cmd->name)
+				continue;
+
+			size_t slot = mnemonic_hash(multiplier, cmd->name, cmd->name_len);
+			while (mnemonics->slots[slot])
 			{
-				state->error = ALLOC_ERR;
-				return false;
+				perfect = false;
+				slot    = (slot + 1) & (MNEMONIC_SLOTS - 1);
 			}
+
+			mnemonics->slots[slot] = (unsigned char) (opcode + 1);
 		}
 
-		++state->labels.size;
+		if (perfect)
+			return;
 	}
-	else
+}
+
+
+const cmd_info_t* find_cmd (const mnemonic_table_t* mnemonics,
+                            const char* name, size_t name_len)
+{
+	if_log (is_bad_mem(mnemonics, sizeof *mnemonics), ERROR,
+		return NULL;)
+
+	if (name_len == 0)
+		return NULL;
+
+	size_t slot = mnemonic_hash(mnemonics->multiplier, name, name_len);
+	while (mnemonics->slots[slot])
 	{
-		if (is_label_declaration)
-		{
-			label->address = state->ip;
-		}
-		else
-		{
-			if (!add_code_place(label, state->ip, &state->error))
-			{
-				state->error = ALLOC_ERR;
-				return false;
-			}
-		}
+		const cmd_info_t* cmd = CMD_INFO + mnemonics->slots[slot] - 1;
+		if (cmd->name_len == name_len
+		    && memcmp(cmd->name, name, name_len) == 0)
+			return cmd;
+
+		slot = (slot + 1) & (MNEMONIC_SLOTS - 1);
 	}
 
-	return true;
+	return NULL;
 }
 
 
-#define DEF_CMD(CMD_, NUM_, ARG_, ...) else if (strcmp(#CMD_, token) == 0) \
-                                        return handle_cmd_##ARG_(state, NUM_);
-
-bool compile_cmd (assembler_state_t state, const char* token)
+bool compile_cmd (assembler_state_t state, token_t token)
 {
 	if_log (is_bad_mem(state, sizeof *state), ERROR,
 		return false;)
 
-	if_log (is_bad_byte_ptr(token), ERROR,
-		return false;)
-
-	if (false);
-	#include "../DEF_CMD" // e.g. else if (strcmp("add", token) == 0)
-	                      //      	return handle_cmd_NO_ARGS(state, 11);
-	else
+	const cmd_info_t* cmd = find_cmd(&state->mnemonics, token.begin, token.len);
+	if (!cmd)
 	{
-		print_error(UNKNOWN_CMD, token);
-		state->error = UNKNOWN_CMD;
+		token_error(state, UNKNOWN_CMD, token);
 		return false;
 	}
-}
 
-#undef DEF_CMD
+	int instruction = (int) (cmd - CMD_INFO);
+	switch (cmd->arg)
+	{
+		case LABEL_ARG:
+			return handle_cmd_LABEL_ARG(state, instruction);
+
+		case MEMORY_ARG:
+			return handle_cmd_MEMORY_ARG(state, instruction);
+
+		case NO_ARGS:
+		default:
+			return handle_cmd_NO_ARGS(state, instruction);
+	}
+}
 
 
 bool handle_cmd_NO_ARGS (assembler_state_t state, int instruction)
@@ -333,25 +803,22 @@ bool handle_cmd_LABEL_ARG (assembler_state_t state, int instruction)
 	if_log (is_bad_mem(state, sizeof *state), ERROR,
 		return false;)
 
-	int  was_read = 0;
-	char label[MAX_TOKEN_SIZE];
-	if (sscanf(state->io.input + state->pos, "%s%n", label, &was_read) != 1)
+	if (!skip_blanks(state))
 	{
-		print_error(MISSING_ARG, "LABEL");
-		state->error = MISSING_ARG;
+		report_error(state, MISSING_ARG, "LABEL");
 		return false;
 	}
-	
-	state->pos += was_read;
-	if (!update_label(state, label, false))
+
+	token_t label = read_token(state, false);
+	write_instruction(state, instruction);
+	if (!update_label(state, label.begin, label.len, false))
 	{
-		state->error = ALLOC_ERR;
-		print_error(ALLOC_ERR, label);
+		token_error(state, ALLOC_ERR, label);
 		return false;
 	}
 
-	write_instruction(state, instruction);
-	write_arg(state, &state->ip, sizeof state->ip);
+	addr_t address = 0;
+	write_arg(state, &address, sizeof address);
 
 	return true;
 }
@@ -362,38 +829,34 @@ bool handle_cmd_MEMORY_ARG (assembler_state_t state, int instruction)
 	if_log (is_bad_mem(state, sizeof *state), ERROR,
 		return false;)
 
-	char arg[MAX_TOKEN_SIZE] = {};
-	int was_read = 0;
-	if (sscanf(state->io.input + state->pos, "%s%n", arg, &was_read) != 1)
+	if (!skip_blanks(state))
 	{
-		print_error(MISSING_ARG, "MEMORY");
-		state->error = MISSING_ARG;
+		report_error(state, MISSING_ARG, "MEMORY");
 		return false;
 	}
 
-	state->pos              += was_read;
+	token_t           arg    = read_token(state, false);
+	token_t           value  = arg;
 	reg_t             reg    = REG_ax;
 	processor_value_t val    = 0;
 	addr_t            offset = 0;
-	char              extracted_addr[MAX_TOKEN_SIZE];
-	if (is_addr(arg, extracted_addr, &offset))
+	if (is_addr(arg, &value, &offset))
 		instruction |= ADDR_ARG;
 	
-	if (is_reg(extracted_addr, &reg))
+	if (is_reg(value, &reg))
 	{
 		instruction |= REG_ARG;
 		write_instruction(state, instruction);
 		write_arg(state, &reg, sizeof reg);
 	}
-	else if (is_const(extracted_addr, &val))
+	else if (is_const(value, &val))
 	{
 		write_instruction(state, instruction);
 		write_arg(state, &val, sizeof val);
 	}
 	else
 	{
-		print_error(WRONG_ARG, arg);
-		state->error = WRONG_ARG;
+		token_error(state, WRONG_ARG, arg);
 		return false;
 	}
 
@@ -409,42 +872,142 @@ bool compile_next (assembler_state_t state)
 	if_log (is_bad_mem(state, sizeof *state), ERROR,
 		return false;)
 
-	char token[MAX_TOKEN_SIZE];
-	char tmp[10];
-	int  was_read = 0;
+	if (!skip_blanks(state))
+		return false;
 
-	if (sscanf(state->io.input + state->pos,
-	           " %[^: \n\t\r\f\v]%1[:]%n", token, tmp, &was_read) == 2)
+	token_t token = read_token(state, true);
+	if (state->io.input[state->pos] == ':')
 	{
-		state->pos += was_read;
-		if (!update_label(state, token, true))
+		if (token.len == 0)
+		{
+			token_error(state, WRONG_TOKEN, (token_t) { token.begin, 1 });
+			return false;
+		}
+
+		++state->pos;
+		if (!update_label(state, token.begin, token.len, true))
 		{
 			if (state->error == ALLOC_ERR)
-				print_error(ALLOC_ERR, "changing label's table");
+				report_error(state, ALLOC_ERR, "changing label's table");
 			return false;
 		}
 		else
 			return true;
 	}
-	else if (sscanf(state->io.input + state->pos, " %[A-Za-z]%n",
-	                token, &was_read) == 1)
+
+	size_t letters = 0;
+	while (letters < token.len && is_letter(token.begin[letters]))
+		++letters;
+
+	if (letters == 0)
+	{
+		token_error(state, WRONG_TOKEN, token);
+		return false;
+	}
+
+	/* mnemonic is made of letters, the rest of token is its argument     */
+	state->pos -= token.len - letters;
+	token.len   = letters;
+	return compile_cmd(state, token);
+}
+
+
+bool compile_chunks (assembler_state_t state, size_t jobs)
+{
+	if_log (is_bad_mem(state, sizeof *state), ERROR,
+		return false;)
+
+	io_t* io = &state->io;
+	if (jobs > MAX_JOBS)
+		jobs = MAX_JOBS;
+
+	if (jobs > io->input_size / MIN_JOB_INPUT_SIZE)
+		jobs = io->input_size / MIN_JOB_INPUT_SIZE;
+
+	if (jobs < 2)
+		return false;
+
+	/* parts end at line boundaries which are replaced by null characters
+	 * until threads are finished                                        */
+	asm_chunk_t chunks[MAX_JOBS] = {};
+	size_t      ends[MAX_JOBS]   = {};
+	size_t      amount           = 0;
+	for (size_t begin = 0; begin < io->input_size; begin = ends[amount++] + 1)
 	{
-		state->pos += was_read;
-		return compile_cmd(state, token);
+		size_t end  = io->input_size;
+		size_t goal = (amount + 1) * io->input_size / jobs;
+		if (goal < begin)
+			goal = begin;
+
+		const char* endl = memchr(io->input + goal, '\n', io->input_size - goal);
+		if (amount + 1 < jobs && endl)
+			end = (size_t) (endl - io->input);
+
+		io->input[end]       = '\0';
+		ends[amount]         = end;
+		chunks[amount].state = asm_chunk_init(io->input + begin, end - begin);
 	}
-	else if (sscanf(state->io.input + state->pos, " %s%n",
-	                token, &was_read) == 1)
+
+	bool compiled = true;
+	for (size_t i = 0; i < amount; ++i)
+		compiled = compiled && chunks[i].state;
+
+	if (compiled)
+		run_chunks(chunks, amount, compile_chunk);
+
+	for (size_t i = 0; i < amount; ++i)
 	{
-		state->pos += was_read;
-		print_error(WRONG_TOKEN, token);
-		state->error = WRONG_TOKEN;
+		if (ends[i] < io->input_size)
+			io->input[ends[i]] = '\n';
+
+		compiled = compiled && chunks[i].state->error == NO_PROC_ERR;
 	}
 
-	return false;
+	addr_t base = state->ip;
+	for (size_t i = 0; compiled && i < amount; ++i)
+	{
+		chunks[i].base  = base;
+		base           += chunks[i].state->ip;
+	}
+
+	/* errors are reported by compilation in one thread                 */
+	compiled = compiled && merge_labels(state, chunks, amount);
+	for (size_t i = 0; compiled && i < state->labels.size; ++i)
+		compiled = state->labels.table[i].declared;
+
+	if (compiled)
+	{
+		run_chunks(chunks, amount, patch_chunk);
+
+		for (size_t i = 0; i < amount && flush_output(state); ++i)
+		{
+			const io_t* part = &chunks[i].state->io;
+			if (fwrite(part->output, 1, part->output_size, io->file)
+			    != part->output_size)
+			{
+				report_error(state, WRITE_ERR, " Assembler's output.");
+				break;
+			}
+
+			io->flushed += part->output_size;
+			state->ip   += chunks[i].state->ip;
+		}
+	}
+	else
+		clear_labels(&state->labels);
+
+	for (size_t i = 0; i < amount; ++i)
+	{
+		if (chunks[i].state)
+			asm_state_delete(chunks[i].state);
+		free(chunks[i].labels);
+	}
+
+	return compiled;
 }
 
 
-proc_error_t compile (FILE* output, FILE* input)
+proc_error_t compile (FILE* output, FILE* input, size_t jobs)
 {
 	if_log (is_bad_mem(output, sizeof *output), ERROR,
 		return WRONG_ARG;)
@@ -452,20 +1015,29 @@ proc_error_t compile (FILE* output, FILE* input)
 	if_log (is_bad_mem(input, sizeof *input), ERROR,
 		return WRONG_ARG;)
 
-	assembler_state_t state = asm_state_init(input);
-
-	remove_comments(state);
+	assembler_state_t state = asm_state_init(input, output);
+	if (!state)
+	{
+		print_error(ALLOC_ERR, "compilation state");
+		return ALLOC_ERR;
+	}
 
 	write_header(state);
 
-	while (compile_next(state))
-		continue;
+	if (state->error != NO_PROC_ERR || !compile_chunks(state, jobs))
+	{
+		while (state->error == NO_PROC_ERR && compile_next(state))
+			continue;
 
-	insert_labels_addresses(state);
+		if (state->error == NO_PROC_ERR && insert_labels_addresses(state))
+			flush_output(state);
+	}
 
+	/* output of failed compilation is left empty                        */
 	proc_error_t err = state->error;
-	if (err == NO_PROC_ERR)
-		fwrite(state->io.output, sizeof *state->io.output, state->ip, output);
+	if (err != NO_PROC_ERR && state->io.flushed
+	    && (fflush(output) != 0 || ftruncate(fileno(output), 0) != 0))
+		print_error(WRITE_ERR, " Assembler's output.");
 
 	asm_state_delete(state);
 	return err;
@@ -474,59 +1046,85 @@ proc_error_t compile (FILE* output, FILE* input)
 
 void write_instruction (assembler_state_t state, int instruction)
 {
-	state->io.output[state->ip] = (char) instruction;
-	++state->ip;
+	char byte = (char) instruction;
+	write_bytes(state, &byte, sizeof byte);
 }
 
 
 void write_arg (assembler_state_t state, const void* arg, size_t size)
 {
-	memcpy(state->io.output + state->ip, arg, size);
-	state->ip += size;
+	write_bytes(state, arg, size);
 }
 
 
-bool is_addr (char* arg, char* extracted_val, addr_t* offset)
+bool is_addr (token_t arg, token_t* extracted_addr, addr_t* offset)
 {
-	char tmp[10];
-	
-	// 0x5B == '[' && 0x5D == ']'
-	if (sscanf(arg, "\x5B%[^\x5D]%1[\x5D]", extracted_val, tmp) == 2)
+	size_t pos      = 0;
+	addr_t number   = 0;
+	bool   negative = false;
+	if (arg.len > 0 && (arg.begin[0] == '-' || arg.begin[0] == '+'))
 	{
-		*offset = 0;
-		return true;
+		negative = (arg.begin[0] == '-');
+		++pos;
 	}
 
-	if (sscanf(arg, "%llu\x5B%[^\x5D]%1[\x5D]", offset, extracted_val, tmp) == 3)
-		return true;
+	size_t digits = pos;
+	while (pos < arg.len && is_digit(arg.begin[pos]))
+		number = number * 10 + (addr_t) (arg.begin[pos++] - '0');
 
-	strcpy(extracted_val, arg);
-	return false;
+	/* address is [value] or offset[value], signed offset wraps around
+	 * like sum of offset and register does in the processor            */
+	bool sign_only = (pos == digits && digits > 0);
+	if (sign_only || arg.len < pos + 3 || arg.begin[pos] != '['
+	    || arg.begin[arg.len - 1] != ']'
+	    || memchr(arg.begin + pos + 1, ']', arg.len - pos - 2))
+	{
+		*extracted_addr = arg;
+		return false;
+	}
+
+	*offset         = negative ? 0 - number : number;
+	*extracted_addr = (token_t) { arg.begin + pos + 1, arg.len - pos - 2 };
+	return true;
 }
 
 
-bool is_reg (char* arg, reg_t* reg)
+bool is_reg (token_t arg, reg_t* reg)
 {
-	char reg_letter = 0;
-	char tmp;
-	if (sscanf(arg, "%cx%c", &reg_letter, &tmp) == 1)
+	if (arg.len == 2 && arg.begin[1] == 'x'
+	    && 'a' <= arg.begin[0] && arg.begin[0] < 'a' + REGS_NUMBER)
 	{
-		if ('a' <= reg_letter && reg_letter < 'a' + REGS_NUMBER)
-		{
-			*reg = reg_letter - 'a';
-			return true;
-		}
+		*reg = (reg_t) (arg.begin[0] - 'a');
+		return true;
 	}
 
 	return false;
 }
 
 
-bool is_const (char* arg, processor_value_t* val)
+bool is_const (token_t arg, processor_value_t* val)
 {
-	char tmp;
-	if (sscanf(arg, "%d%c", val, &tmp) == 1)
-		return true;
+	size_t pos      = 0;
+	bool   negative = false;
+	if (arg.len > 0 && (arg.begin[0] == '-' || arg.begin[0] == '+'))
+	{
+		negative = (arg.begin[0] == '-');
+		++pos;
+	}
 
-	return false;
+	if (pos == arg.len)
+		return false;
+
+	/* overflow wraps around like arithmetic commands do                */
+	uint32_t abs_val = 0;
+	for (; pos < arg.len; ++pos)
+	{
+		if (!is_digit(arg.begin[pos]))
+			return false;
+
+		abs_val = abs_val * 10 + (uint32_t) (arg.begin[pos] - '0');
+	}
+
+	*val = (processor_value_t) (negative ? 0u - abs_val : abs_val);
+	return true;
 }
@@ -17,7 +17,51 @@
 #include "../commands.h"
 
 #include <stdio.h>
+#include <stdint.h>
 #include <stdbool.h>
+#include <pthread.h>
+
+
+
+
+/*=========================== Constants declaration =========================*/
+
+/*!
+ * Initial amount of slots in label's table. It must be a power of two.
+ */
+#define LABELS_INIT_SLOTS (size_t) 256
+
+/*!
+ * Initial capacity of label's table, its names and patches.
+ */
+#define LABELS_INIT_CAPACITY (size_t) 128
+
+/*!
+ * Amount of slots in mnemonic's table. It must be a power of two
+ * not less than CMD_AMOUNT.
+ */
+#define MNEMONIC_SLOTS (size_t) 64
+
+/*!
+ * Initial capacity of output's chunk.
+ */
+#define OUTPUT_INIT_CAPACITY (size_t) 4096
+
+/*!
+ * Size of output's chunk which is written into output file
+ * instead of growing.
+ */
+#define OUTPUT_CHUNK_SIZE (size_t) (1 << 20)
+
+/*!
+ * Max amount of threads which compile one file.
+ */
+#define MAX_JOBS (size_t) 64
+
+/*!
+ * Min size of source code which is compiled by one thread.
+ */
+#define MIN_JOB_INPUT_SIZE (size_t) (1 << 16)
 
 
 
@@ -26,54 +70,130 @@
 
 /*!
  * Structure includes input and output data.
+ *
+ * Output is collected in a chunk which grows geometrically. If output
+ * file is set, chunk of OUTPUT_CHUNK_SIZE bytes is written into it
+ * instead of growing further.
  */
 typedef struct io_t_
 {
-	char* input;  /*!< source code string.                                   */
-	char* output; /*!< output data.                                          */
+	char*  input;           /*!< source code string.                         */
+	size_t input_size;      /*!< length of source code.                      */
+	bool   borrowed;        /*!< input belongs to another state.             */
+	FILE*  file;            /*!< output file or NULL if the whole output
+	                             stays in chunk.                             */
+	char*  output;          /*!< chunk of output which isn't written yet.    */
+	size_t output_size;     /*!< size of chunk.                              */
+	size_t output_capacity; /*!< capacity of chunk.                          */
+	addr_t flushed;         /*!< amount of bytes written into file
+	                             before chunk.                               */
 }
 io_t;
 
 /*!
- * Type of label.
+ * View of token in source code. Token isn't null-terminated.
+ */
+typedef struct token_t_
+{
+	const char* begin; /*!< first character of token.                        */
+	size_t      len;   /*!< length of token.                                 */
+}
+token_t;
+
+/*!
+ * Type of label. Its name is interned in names of label's table.
  */
 typedef struct label_t_
 {
-	char    name[MAX_TOKEN_SIZE]; /*!< name of label.                        */
-	addr_t  address;              /*!< address of label.                     */
-	size_t  use_amount;           /*!< amount of instructions 
-	                                   which use this label.                 */
-	size_t  capacity;             /*!< capacity of array with places 
-	                                   where this label was used.            */
-	addr_t* use;                  /*!< places where this label was used.     */
+	size_t   name;     /*!< offset of name in label's names.                 */
+	size_t   name_len; /*!< length of name.                                  */
+	uint64_t hash;     /*!< hash of name.                                    */
+	addr_t   address;  /*!< address of label.                                */
+	bool     declared; /*!< label is declared.                               */
 }
 label_t;
 
+/*!
+ * Place in output where label's address should be inserted.
+ */
+typedef struct label_patch_t_
+{
+	size_t label; /*!< index of label in label's table.                      */
+	addr_t place; /*!< offset of address in output.                          */
+}
+label_patch_t;
+
 /*!
  * Label table type.
+ *
+ * Labels are stored in order of their first occurrence. They are found
+ * through open-addressing hash table slots with linear probing.
+ * Places of all labels' uses are stored in one patch array.
  */
 typedef struct label_table_t_
 {
-	label_t* table; /*!< array with labels.                                  */
-	size_t size;    /*!< size of label table.                                */
-	size_t capacity; /*!< capacity of label's table.                          */
+	label_t*       table;            /*!< array with labels.                 */
+	size_t         size;             /*!< size of label table.               */
+	size_t         capacity;         /*!< capacity of label's table.         */
+	size_t*        slots;            /*!< indices of labels increased by one
+	                                      or 0 if slot is empty.             */
+	size_t         slots_amount;     /*!< amount of slots, power of two.     */
+	char*          names;            /*!< null-terminated names of labels.   */
+	size_t         names_size;       /*!< size of names.                     */
+	size_t         names_capacity;   /*!< capacity of names.                 */
+	label_patch_t* patches;          /*!< places where labels were used.     */
+	size_t         patches_size;     /*!< amount of patches.                 */
+	size_t         patches_capacity; /*!< capacity of patches.               */
 }
 label_table_t;
 
+/*!
+ * Hash table which finds commands by their mnemonics.
+ *
+ * Hash of mnemonic is (first + multiplier * last + length) % MNEMONIC_SLOTS
+ * where first and last are its characters. Multiplier is chosen when
+ * table is built from CMD_INFO so that every command has its own slot,
+ * so lookup costs one hash and one comparison.
+ */
+typedef struct mnemonic_table_t_
+{
+	unsigned char slots[MNEMONIC_SLOTS]; /*!< opcodes increased by one
+	                                          or 0 if slot is empty.         */
+	size_t        multiplier;            /*!< multiplier of last character.  */
+}
+mnemonic_table_t;
+
 /*!
  * State's of compilation type.
  */
 typedef struct assembler_state_t_
 {
-	io_t          io;     /*!< input/output files.                           */
-	label_table_t labels; /*!< table of lables that are contained.           */
-	addr_t        ip;     /*!< current instruction pointer.                  */
-	size_t        pos;    /*!< position in input file.                       */
-	proc_error_t  error;  /*!< error that occured during the 
-	                           compilation process.                          */
+	io_t             io;        /*!< input/output files.                     */
+	label_table_t    labels;    /*!< table of lables that are contained.     */
+	mnemonic_table_t mnemonics; /*!< table of commands.                      */
+	addr_t           ip;        /*!< current instruction pointer.            */
+	size_t           pos;       /*!< position in input file.                 */
+	proc_error_t     error;     /*!< error that occured during the 
+	                                 compilation process.                    */
+	bool             quiet;     /*!< errors aren't printed.                  */
 }
 *assembler_state_t;
 
+/*!
+ * Part of source code which is compiled by its own thread.
+ */
+typedef struct asm_chunk_t_
+{
+	assembler_state_t    state;   /*!< compilation state of part.            */
+	addr_t               base;    /*!< address of part in output.            */
+	size_t*              labels;  /*!< indices of part's labels in label's
+	                                   table of the whole file.              */
+	const label_table_t* global;  /*!< label's table of the whole file.      */
+	pthread_t            thread;  /*!< thread which processes part.          */
+	bool                 started; /*!< thread is started.                    */
+}
+asm_chunk_t;
+
 
 
 
@@ -90,7 +210,8 @@ FILE* create_executable
 );
 
 /*!
- * This function writes bytes into output string and moves instruction pointer.
+ * This function writes bytes into output chunk and moves instruction pointer.
+ * Chunk grows or is written into output file if it is full.
  */
 void write_bytes 
 (
@@ -106,7 +227,22 @@ void write_bytes
  */
 assembler_state_t asm_state_init
 (
-	FILE* in    /*!< [in] input of compilation.                              */
+	FILE* in,   /*!< [in] input of compilation.                              */
+	FILE* out   /*!< [in] file for output chunks or NULL
+	                      if output stays in memory.                         */
+);
+
+/*!
+ * Constructor of state which compiles a part of source code of another
+ * state. Its output stays in memory, its addresses start from 0 and its
+ * errors aren't printed.
+ *
+ * @return assembler_state_t object if success else NULL
+ */
+assembler_state_t asm_chunk_init
+(
+	char*  input,     /*!< [in] null-terminated part of source code.         */
+	size_t input_size /*!< [in] length of part.                              */
 );
 
 /*!
@@ -120,27 +256,31 @@ assembler_state_t asm_state_delete
 );
 
 /*!
- * Removes all comments from source code.
+ * It writes signature and version into output file.
  */
-void remove_comments 
+void write_header 
 (
 	assembler_state_t state /*!< [in,out] compilation state.                 */
 );
 
 /*!
- * It writes signature and version into output file.
+ * Insert labels addresses instead of their ids.
+ * Places which are already written into output file are rewritten there,
+ * so file must be opened for update.
+ *
+ * @return success of this operation.
  */
-void write_header 
+bool insert_labels_addresses
 (
 	assembler_state_t state /*!< [in,out] compilation state.                 */
 );
 
 /*!
- * Insert labels addresses instead of their ids.
+ * Write the rest of output chunk into output file.
  *
  * @return success of this operation.
  */
-bool insert_labels_addresses
+bool flush_output
 (
 	assembler_state_t state /*!< [in,out] compilation state.                 */
 );
@@ -148,32 +288,41 @@ bool insert_labels_addresses
 /*!
  * This function compile pegas file.
  *
+ * If jobs is greater than one, source code is split at line boundaries
+ * and its parts are compiled by threads, then their labels are merged and
+ * addresses are inserted by threads too. If it fails, file is compiled
+ * again by one thread, so errors are reported as usual.
+ *
  * @return error code that occured during the execution.
  */
 proc_error_t compile
 (
- 	FILE* output, /*!< [out] output file.                                    */
-	FILE* input   /*!< [in]  input file.                                     */
+ 	FILE*  output, /*!< [out] output file opened for update.                 */
+	FILE*  input,  /*!< [in]  input file.                                    */
+	size_t jobs    /*!< [in]  max amount of threads.                         */
 );
 
 /*!
- * Compile next command from input.
+ * Compile source code of state by parts in parallel threads and write
+ * output after header.
  *
- * @return success of this operation.
+ * @return true if output is written or error is reported, false if
+ *         file should be compiled by one thread.
  */
-bool compile_next 
+bool compile_chunks
 (
-	assembler_state_t state /*!< [in,out] compilation state.                 */
+	assembler_state_t state, /*!< [in,out] compilation state with header.    */
+	size_t            jobs   /*!< [in]     max amount of threads.            */
 );
 
 /*!
- * Increase capacity of label's table.
+ * Compile next command from input.
  *
  * @return success of this operation.
  */
-bool increase_labels_capacity 
+bool compile_next 
 (
-	assembler_state_t state /*!< compilation state.                          */
+	assembler_state_t state /*!< [in,out] compilation state.                 */
 );
 
 /*!
@@ -185,6 +334,7 @@ bool update_label
 (
 	assembler_state_t state,               /*!< [in,out] compilation state.  */
 	const char*       name,                /*!< [in]     label name.         */
+	size_t            name_len,            /*!< [in]     length of name.     */
 	bool              is_label_declaration /*!< [in]     is this function 
 	                                                     used with new label
 	                                                     declaration.        */
@@ -197,31 +347,56 @@ bool update_label
  */
 label_t* find_label
 (
-	const label_table_t labels, /*!< [in] label's table.                     */
-	const char* name            /*!< [in] name of label for searching.       */
+	const label_table_t* labels,   /*!< [in] label's table.                  */
+	const char*          name,     /*!< [in] name of label for searching.    */
+	size_t               name_len  /*!< [in] length of name.                 */
 );
 
 /*!
- * Initialize new label at the end of label table.
+ * Initialize new label at the end of label table and intern its name.
+ * Label mustn't be in the table yet.
+ *
+ * @return pointer to new label or NULL if table can't be extended.
+ */
+label_t* create_label 
+(
+	assembler_state_t state,    /*!< [in,out] compilation state              */
+	const char*       name,     /*!< [in]     label's name.                  */
+	size_t            name_len  /*!< [in]     length of name.                */
+);
+
+/*!
+ * This function adds place in output where the particular label 
+ * was used.
  *
  * @return success of this operation.
  */
-bool create_label 
+bool add_label_patch
 (
-	assembler_state_t state, /*!< [in,out] compilation state                 */
-	const char*       name   /*!< [in]     label's name.                     */
+	label_table_t* labels, /*!< [in,out] label's table.                      */
+	size_t         label,  /*!< [in]     index of used label.                */
+	addr_t         place   /*!< [in]     offset of label's address
+	                                     in output.                          */
+);
+
+/*!
+ * Build mnemonic's table from CMD_INFO.
+ */
+void init_mnemonics
+(
+	mnemonic_table_t* mnemonics /*!< [out] mnemonic's table.                 */
 );
 
 /*!
- * This function adds place in source code where the particular label 
- * was occured.
+ * This function finds command by its mnemonic.
+ *
+ * @return pointer to command in CMD_INFO or NULL if it doesn't exist.
  */
-bool add_code_place
+const cmd_info_t* find_cmd
 (
-	label_t*      label, /*!< [in,out] label that occured in source code.    */
-	addr_t        addr,  /*!< [in]     address of label in source code.      */
-	proc_error_t* err    /*!< [out]    pointer to variable 
-	                                   in which error will be written.       */
+	const mnemonic_table_t* mnemonics, /*!< [in] mnemonic's table.           */
+	const char*             name,      /*!< [in] mnemonic.                   */
+	size_t                  name_len   /*!< [in] length of mnemonic.         */
 );
 
 /*!
@@ -232,7 +407,7 @@ bool add_code_place
 bool compile_cmd 
 (
 	assembler_state_t state, /*!< [in,out] compilation state.                */
-	const char*       token  /*!< [in]     token to be compiled.             */
+	token_t           token  /*!< [in]     token to be compiled.             */
 );
 
 /*!
@@ -293,17 +468,17 @@ void write_arg
  *
  * If argument is address function will extract address variable into
  * extracted_addr variable.
- * If argument isn't an address function copies arg 
+ * If argument isn't an address function assigns arg 
  * to extracted_addr variable.
  *
  * @return is argument address.
  */
 bool is_addr
 (
-	char*   arg,            /*!< [in]  input argument.                       */
-	char*   extracted_addr, /*!< [out] string in which extracted 
-	                                   address variable will be written.     */
-	addr_t* offset          /*!< [out\ offset of address.                    */
+	token_t  arg,            /*!< [in]  input argument.                      */
+	token_t* extracted_addr, /*!< [out] view of extracted 
+	                                    address variable.                    */
+	addr_t*  offset          /*!< [out] offset of address.                   */
 );
 
 /*!
@@ -313,9 +488,9 @@ bool is_addr
  */
 bool is_reg
 (
-	char*  arg, /*!< [in]  input argument.                                   */
-	reg_t* reg  /*!< [out] pointer to value in which 
-	                       parsed value will be written.                     */
+	token_t arg, /*!< [in]  input argument.                                  */
+	reg_t*  reg  /*!< [out] pointer to value in which 
+	                        parsed value will be written.                    */
 );
 
 /*!
@@ -325,7 +500,7 @@ bool is_reg
  */
 bool is_const
 (
-	char*              arg, /*!< [in]  input argument.                       */
+	token_t            arg, /*!< [in]  input argument.                       */
 	processor_value_t* val  /*!< [out] pointer to value in which 
 	                                   parsed value will be written.         */
 );
@@ -7,11 +7,27 @@
 #include "assembler.h"
 
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 
 
 int main (int argc, char* argv[])
 {
+	size_t jobs = 1;
+	if (argc == 4 && strcmp(argv[1], "-j") == 0)
+	{
+		char* end = NULL;
+		jobs = strtoul(argv[2], &end, 10);
+		if (*end != '\0' || jobs == 0 || jobs > MAX_JOBS)
+		{
+			fputs("Wrong amount of jobs.\n", stderr);
+			return 1;
+		}
+
+		argv += 2;
+		argc -= 2;
+	}
+
 	if (argc != 2)
 	{
 		fputs("Wrong amount of arguments.\n", stderr);
@@ -38,7 +54,7 @@ int main (int argc, char* argv[])
 		return 1;
 	}
 
-	if (compile(output, input) != NO_PROC_ERR)
+	if (compile(output, input, jobs) != NO_PROC_ERR)
 		return 1;
 
 	fclose(output);
@@ -0,0 +1,642 @@
+/*!
+ * @file
+ * @brief End-to-end benchmark of the processor.
+ *
+ * Every workload is assembled into a temporary directory, executed once
+ * by the switch engine with --count to get amount of executed
+ * instructions and then executed the given number of times with the
+ * measured options. Time is wall time from fork() to wait4(), so it
+ * includes loading, verification and analysis of the program.
+ */
+
+#define _DEFAULT_SOURCE
+
+
+
+/*============================ Including headers ============================*/
+
+
+#include "bench.h"
+#include "../libs/others.h"
+#include "../libs/logging.h"
+#include "../libs/text_edit.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/wait.h>
+#include <sys/resource.h>
+
+
+
+
+/*======================== Macros & static functions ========================*/
+
+
+static bool redirect (int fd, const char* fname, int flags)
+{
+	int new_fd = open(fname, flags, 0644);
+	if (new_fd < 0)
+		return false;
+
+	bool success = dup2(new_fd, fd) >= 0;
+	close(new_fd);
+	return success;
+}
+
+
+/*
+ * Run program and wait for it. stdout of program is discarded,
+ * stdin and stderr are redirected to files if they are given.
+ */
+static bool spawn (char* const argv[], const char* in, const char* err,
+                   double* time_ns, long* rss)
+{
+	struct timespec start = {};
+	struct timespec end   = {};
+	clock_gettime(CLOCK_MONOTONIC, &start);
+
+	pid_t pid = fork();
+	if (pid < 0)
+		return false;
+
+	if (pid == 0)
+	{
+		if (!redirect(STDIN_FILENO,  in ? in : "/dev/null", O_RDONLY)
+		    || !redirect(STDOUT_FILENO, "/dev/null", O_WRONLY)
+		    || !redirect(STDERR_FILENO, err ? err : "/dev/null",
+		                 O_WRONLY | O_CREAT | O_TRUNC))
+			_exit(127);
+
+		execv(argv[0], argv);
+		_exit(127);
+	}
+
+	int           status = 0;
+	struct rusage usage  = {};
+	if (wait4(pid, &status, 0, &usage) < 0)
+		return false;
+
+	clock_gettime(CLOCK_MONOTONIC, &end);
+
+	if (time_ns)
+		*time_ns = (double) (end.tv_sec - start.tv_sec) * 1e9
+		         + (double) (end.tv_nsec - start.tv_nsec);
+
+	if (rss)
+		*rss = usage.ru_maxrss;
+
+	return WIFEXITED(status) && WEXITSTATUS(status) == 0;
+}
+
+
+static bool copy_file (const char* from, const char* to)
+{
+	FILE* in = fopen(from, "rb");
+	if (!in)
+		return false;
+
+	size_t size = 0;
+	char*  data = read_file(in, &size);
+	fclose(in);
+	if (!data)
+		return false;
+
+	FILE* out = fopen(to, "wb");
+	bool  success = out && fwrite(data, 1, size, out) == size;
+	if (out)
+		success = (fclose(out) == 0) && success;
+
+	free(data);
+	return success;
+}
+
+
+/*
+ * Name of workload is name of its source without directory and extension.
+ */
+static void workload_name (const char* asm_file, char* name)
+{
+	const char* base = strrchr(asm_file, '/');
+	base = base ? base + 1 : asm_file;
+
+	strncpy(name, base, MAX_NAME_SIZE - 1);
+	name[MAX_NAME_SIZE - 1] = '\0';
+
+	char* dot = strrchr(name, '.');
+	if (dot)
+		*dot = '\0';
+}
+
+
+static bool count_instructions (const bench_options_t* options,
+                                const char* program, const char* input,
+                                const char* dir,
+                                unsigned long long* instructions)
+{
+	char err[MAX_PATH_SIZE];
+	snprintf(err, sizeof err, "%s/count.txt", dir);
+
+	char* argv[] =
+	{
+		(char*) options->exec_path, "--headless", "--count",
+		(char*) program, NULL
+	};
+
+	bool success = spawn(argv, input, err, NULL, NULL);
+
+	FILE* log = fopen(err, "r");
+	if (!log)
+		return false;
+
+	char line[MAX_PATH_SIZE];
+	success = false;
+	while (fgets(line, sizeof line, log))
+	{
+		if (sscanf(line, "Executed instructions: %llu", instructions) == 1)
+			success = true;
+	}
+
+	fclose(log);
+	remove(err);
+	return success;
+}
+
+
+static int compare_doubles (const void* a, const void* b)
+{
+	double x = *(const double*) a;
+	double y = *(const double*) b;
+	return (x > y) - (x < y);
+}
+
+
+/*
+ * Continued fraction for incomplete beta function (modified Lentz's method).
+ */
+static double beta_fraction (double a, double b, double x)
+{
+	const int    MAX_ITERATIONS = 300;
+	const double EPSILON        = 1e-14;
+	const double TINY           = 1e-300;
+
+	double c = 1;
+	double d = 1 - (a + b) * x / (a + 1);
+	if (fabs(d) < TINY)
+		d = TINY;
+
+	d = 1 / d;
+	double fraction = d;
+
+	for (int m = 1; m <= MAX_ITERATIONS; ++m)
+	{
+		double numerator = m * (b - m) * x / ((a + 2 * m - 1) * (a + 2 * m));
+		for (int step = 0; step < 2; ++step)
+		{
+			d = 1 + numerator * d;
+			if (fabs(d) < TINY)
+				d = TINY;
+
+			c = 1 + numerator / c;
+			if (fabs(c) < TINY)
+				c = TINY;
+
+			d         = 1 / d;
+			fraction *= d * c;
+
+			numerator = -(a + m) * (a + b + m) * x
+			          / ((a + 2 * m) * (a + 2 * m + 1));
+		}
+
+		if (fabs(d * c - 1) < EPSILON)
+			break;
+	}
+
+	return fraction;
+}
+
+
+/*
+ * Regularized incomplete beta function I_x(a, b).
+ */
+static double incomplete_beta (double a, double b, double x)
+{
+	if (x <= 0)
+		return 0;
+
+	if (x >= 1)
+		return 1;
+
+	double front = exp(lgamma(a + b) - lgamma(a) - lgamma(b)
+	                   + a * log(x) + b * log(1 - x));
+
+	if (x < (a + 1) / (a + b + 2))
+		return front * beta_fraction(a, b, x) / a;
+
+	return 1 - front * beta_fraction(b, a, 1 - x) / b;
+}
+
+
+static const char* skip_to (const char* str, const char* key, const char* end)
+{
+	const char* found = strstr(str, key);
+	if (!found || (end && found > end))
+		return NULL;
+
+	return found + strlen(key);
+}
+
+
+/*
+ * Read one workload from JSON object which begins at str.
+ *
+ * @return end of the object or NULL if it can't be read.
+ */
+static const char* read_json_result (const char* str, bench_result_t* result)
+{
+	const char* name = skip_to(str, "\"name\": \"", NULL);
+	if (!name)
+		return NULL;
+
+	const char* name_end = strchr(name, '"');
+	if (!name_end || (size_t) (name_end - name) >= MAX_NAME_SIZE)
+		return NULL;
+
+	memcpy(result->name, name, (size_t) (name_end - name));
+	result->name[name_end - name] = '\0';
+
+	const char* end = strchr(name_end, '}');
+	const char* instr = skip_to(name_end, "\"instructions\": ", end);
+	if (instr)
+		result->instructions = strtoull(instr, NULL, 10);
+
+	const char* samples = skip_to(name_end, "\"samples_ns\": [", end);
+	if (!samples)
+		return NULL;
+
+	size_t capacity = 16;
+	result->samples = (double*) calloc(capacity, sizeof *result->samples);
+	if (!result->samples)
+		return NULL;
+
+	while (*samples != ']')
+	{
+		char*  num_end = NULL;
+		double sample  = strtod(samples, &num_end);
+		if (num_end == samples)
+			return NULL;
+
+		if (result->samples_amount == capacity)
+		{
+			capacity *= 2;
+			double* new_samples = (double*)
+				realloc(result->samples, capacity * sizeof *new_samples);
+			if (!new_samples)
+				return NULL;
+
+			result->samples = new_samples;
+		}
+
+		result->samples[result->samples_amount++] = sample;
+
+		samples = num_end + strspn(num_end, ", \t\n");
+	}
+
+	bench_statistics(result);
+	return end;
+}
+
+
+static const bench_result_t* find_result (const bench_result_t* results,
+                                          size_t amount, const char* name)
+{
+	for (size_t i = 0; i < amount; ++i)
+	{
+		if (strcmp(results[i].name, name) == 0)
+			return results + i;
+	}
+
+	return NULL;
+}
+
+
+
+
+/*========================= Functions implementation ========================*/
+
+
+bool bench_workload (const bench_options_t* options, const char* asm_file,
+                     bench_result_t* result)
+{
+	if_log (is_bad_mem(options, sizeof *options), ERROR,
+		return false;)
+
+	if_log (is_bad_byte_ptr(asm_file), ERROR,
+		return false;)
+
+	if_log (is_bad_mem(result, sizeof *result), ERROR,
+		return false;)
+
+	workload_name(asm_file, result->name);
+
+	char input[MAX_PATH_SIZE];
+	snprintf(input, sizeof input, "%s/%s.%s", WORKLOADS_DIR, result->name,
+	         INPUT_EXT);
+	bool has_input = access(input, R_OK) == 0;
+
+	char dir[] = "/tmp/pegas_bench_XXXXXX";
+	if (!mkdtemp(dir))
+	{
+		fputs("Temporary directory cannot be created.\n", stderr);
+		return false;
+	}
+
+	char source[MAX_PATH_SIZE];
+	char program[MAX_PATH_SIZE];
+	snprintf(source,  sizeof source,  "%s/%s.asm",   dir, result->name);
+	snprintf(program, sizeof program, "%s/%s.pegas", dir, result->name);
+
+	char* asm_argv[] = { (char*) options->asm_path, source, NULL };
+
+	bool success = false;
+	if (!copy_file(asm_file, source) || !spawn(asm_argv, NULL, NULL, NULL, NULL))
+		fprintf(stderr, "%s: workload cannot be assembled.\n", result->name);
+	else if (!count_instructions(options, program, has_input ? input : NULL,
+	                             dir, &result->instructions))
+		fprintf(stderr, "%s: instructions cannot be counted.\n", result->name);
+	else
+		success = true;
+
+	const char* exec_argv[MAX_EXEC_OPTIONS + 4] =
+	{
+		options->exec_path, "--headless"
+	};
+	size_t exec_argc = 2;
+	for (size_t i = 0; i < options->exec_options_amount; ++i)
+		exec_argv[exec_argc++] = options->exec_options[i];
+
+	exec_argv[exec_argc++] = program;
+	exec_argv[exec_argc]   = NULL;
+
+	result->samples        = (double*) calloc(options->runs,
+	                                          sizeof *result->samples);
+	result->samples_amount = 0;
+	result->peak_rss       = 0;
+	if (!result->samples)
+		success = false;
+
+	for (size_t i = 0; success && i < options->warmups + options->runs; ++i)
+	{
+		double time_ns = 0;
+		long   rss     = 0;
+		if (!spawn((char* const*) exec_argv, has_input ? input : NULL, NULL,
+		           &time_ns, &rss))
+		{
+			fprintf(stderr, "%s: workload failed.\n", result->name);
+			success = false;
+			break;
+		}
+
+		if (i < options->warmups)
+			continue;
+
+		result->samples[result->samples_amount++] = time_ns;
+		if (rss > result->peak_rss)
+			result->peak_rss = rss;
+	}
+
+	remove(source);
+	remove(program);
+	rmdir(dir);
+
+	if (success)
+		bench_statistics(result);
+
+	return success;
+}
+
+
+void bench_statistics (bench_result_t* result)
+{
+	if_log (is_bad_mem(result, sizeof *result), ERROR,
+		return;)
+
+	size_t n = result->samples_amount;
+	result->mean     = 0;
+	result->median   = 0;
+	result->min      = 0;
+	result->variance = 0;
+	if (n == 0)
+		return;
+
+	double* sorted = (double*) calloc(n, sizeof *sorted);
+	if (!sorted)
+		return;
+
+	memcpy(sorted, result->samples, n * sizeof *sorted);
+	qsort(sorted, n, sizeof *sorted, compare_doubles);
+
+	double sum = 0;
+	for (size_t i = 0; i < n; ++i)
+		sum += sorted[i];
+
+	result->mean   = sum / (double) n;
+	result->min    = sorted[0];
+	result->median = (n % 2) ? sorted[n / 2]
+	                         : (sorted[n / 2 - 1] + sorted[n / 2]) / 2;
+
+	double squares = 0;
+	for (size_t i = 0; i < n; ++i)
+		squares += (sorted[i] - result->mean) * (sorted[i] - result->mean);
+
+	result->variance = (n > 1) ? squares / (double) (n - 1) : 0;
+
+	free(sorted);
+}
+
+
+void bench_print_json (FILE* output, const bench_options_t* options,
+                       const bench_result_t* results, size_t amount)
+{
+	if_log (is_bad_mem(output, sizeof *output), ERROR,
+		return;)
+
+	if_log (is_bad_mem(options, sizeof *options), ERROR,
+		return;)
+
+	fprintf(output, "{\n\t\"runs\": %zu,\n\t\"warmups\": %zu,\n",
+	        options->runs, options->warmups);
+
+	fputs("\t\"exec_options\": [", output);
+	for (size_t i = 0; i < options->exec_options_amount; ++i)
+		fprintf(output, "%s\"%s\"", i ? ", " : "", options->exec_options[i]);
+
+	fputs("],\n\t\"workloads\":\n\t[\n", output);
+
+	for (size_t i = 0; i < amount; ++i)
+	{
+		const bench_result_t* res = results + i;
+
+		double ns_per_instr = res->instructions
+		                    ? res->mean / (double) res->instructions : 0;
+		double instr_per_sec = (res->mean > 0)
+		                     ? (double) res->instructions * 1e9 / res->mean : 0;
+
+		fprintf(output,
+		        "\t\t{\n"
+		        "\t\t\t\"name\": \"%s\",\n"
+		        "\t\t\t\"instructions\": %llu,\n"
+		        "\t\t\t\"mean_ns\": %.1f,\n"
+		        "\t\t\t\"median_ns\": %.1f,\n"
+		        "\t\t\t\"min_ns\": %.1f,\n"
+		        "\t\t\t\"stddev_ns\": %.1f,\n"
+		        "\t\t\t\"variance_ns2\": %.1f,\n"
+		        "\t\t\t\"instructions_per_sec\": %.1f,\n"
+		        "\t\t\t\"ns_per_instruction\": %.4f,\n"
+		        "\t\t\t\"peak_rss_kb\": %ld,\n"
+		        "\t\t\t\"samples_ns\": [",
+		        res->name, res->instructions, res->mean, res->median,
+		        res->min, sqrt(res->variance), res->variance, instr_per_sec,
+		        ns_per_instr, res->peak_rss);
+
+		for (size_t j = 0; j < res->samples_amount; ++j)
+			fprintf(output, "%s%.0f", j ? ", " : "", res->samples[j]);
+
+		fprintf(output, "]\n\t\t}%s\n", (i + 1 < amount) ? "," : "");
+	}
+
+	fputs("\t]\n}\n", output);
+}
+
+
+bench_result_t* bench_read_json (const char* fname, size_t* amount)
+{
+	if_log (is_bad_byte_ptr(fname), ERROR,
+		return NULL;)
+
+	if_log (is_bad_mem(amount, sizeof *amount), ERROR,
+		return NULL;)
+
+	*amount = 0;
+
+	FILE* input = fopen(fname, "rb");
+	if (!input)
+		return NULL;
+
+	size_t size = 0;
+	char*  json = read_file(input, &size);
+	fclose(input);
+	if (!json)
+		return NULL;
+
+	size_t capacity = 0;
+	for (const char* ptr = json; (ptr = strstr(ptr, "\"name\": ")); ++ptr)
+		++capacity;
+
+	bench_result_t* results = (bench_result_t*)
+		calloc(capacity ? capacity : 1, sizeof *results);
+
+	const char* ptr = json;
+	while (results && *amount < capacity)
+	{
+		ptr = read_json_result(ptr, results + *amount);
+		++*amount;
+		if (!ptr)
+		{
+			bench_free_results(results, *amount);
+			results = NULL;
+			*amount = 0;
+		}
+	}
+
+	free(json);
+	return results;
+}
+
+
+void bench_free_results (bench_result_t* results, size_t amount)
+{
+	if (!results)
+		return;
+
+	for (size_t i = 0; i < amount; ++i)
+		free(results[i].samples);
+
+	free(results);
+}
+
+
+welch_t welch_test (const bench_result_t* a, const bench_result_t* b)
+{
+	welch_t test = { .t = 0, .df = 0, .p_value = 1 };
+
+	if_log (is_bad_mem(a, sizeof *a), ERROR,
+		return test;)
+
+	if_log (is_bad_mem(b, sizeof *b), ERROR,
+		return test;)
+
+	if (a->samples_amount < 2 || b->samples_amount < 2)
+		return test;
+
+	double va = a->variance / (double) a->samples_amount;
+	double vb = b->variance / (double) b->samples_amount;
+	if (va + vb == 0)
+	{
+		test.p_value = (a->mean == b->mean) ? 1 : 0;
+		return test;
+	}
+
+	test.t  = (a->mean - b->mean) / sqrt(va + vb);
+	test.df = (va + vb) * (va + vb)
+	        / (va * va / (double) (a->samples_amount - 1)
+	           + vb * vb / (double) (b->samples_amount - 1));
+
+	test.p_value = incomplete_beta(test.df / 2, 0.5,
+	                               test.df / (test.df + test.t * test.t));
+	return test;
+}
+
+
+size_t bench_compare (FILE* output,
+                      const bench_result_t* old, size_t old_amount,
+                      const bench_result_t* new, size_t new_amount,
+                      double alpha)
+{
+	if_log (is_bad_mem(output, sizeof *output), ERROR,
+		return 0;)
+
+	fprintf(output, "%-20s %14s %14s %9s %10s\n",
+	        "workload", "old mean, ms", "new mean, ms", "change", "p-value");
+
+	size_t slower = 0;
+	for (size_t i = 0; i < new_amount; ++i)
+	{
+		const bench_result_t* cur  = new + i;
+		const bench_result_t* base = find_result(old, old_amount, cur->name);
+		if (!base)
+		{
+			fprintf(output, "%-20s missing in baseline\n", cur->name);
+			continue;
+		}
+
+		welch_t     test    = welch_test(base, cur);
+		double      change  = (base->mean > 0)
+		                    ? (cur->mean - base->mean) / base->mean * 100 : 0;
+		const char* verdict = "";
+		if (test.p_value < alpha)
+		{
+			verdict = (change > 0) ? "slower" : "faster";
+			slower += change > 0;
+		}
+
+		fprintf(output, "%-20s %14.3f %14.3f %+8.2f%% %10.4f %s\n",
+		        cur->name, base->mean / 1e6, cur->mean / 1e6, change,
+		        test.p_value, verdict);
+	}
+
+	return slower;
+}
@@ -0,0 +1,189 @@
+/*!
+ * @file
+ * @brief Header for end-to-end benchmark of the processor.
+ */
+
+#ifndef BENCH_H_
+#define BENCH_H_
+
+
+
+
+/*============================ Including headers ============================*/
+
+
+#include <stdio.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+
+
+
+/*=========================== Constants declaration =========================*/
+
+/*!
+ * Directory with synthetic workloads and inputs of all workloads.
+ */
+#define WORKLOADS_DIR "bench/workloads"
+
+/*!
+ * Directory with examples which are also used as workloads.
+ */
+#define EXAMPLES_DIR "examples"
+
+/*!
+ * Extension of files with input of workloads.
+ */
+#define INPUT_EXT "in"
+
+/*!
+ * Maximal amount of options passed to pegas_exec.
+ */
+#define MAX_EXEC_OPTIONS (size_t) 16
+
+/*!
+ * Maximal length of workload's name.
+ */
+#define MAX_NAME_SIZE (size_t) 256
+
+/*!
+ * Maximal length of path used by the benchmark.
+ */
+#define MAX_PATH_SIZE (size_t) 4096
+
+
+
+
+/*============================ Types declaration ============================*/
+
+/*!
+ * Options of benchmark.
+ */
+typedef struct bench_options_t_
+{
+	const char* asm_path;                       /*!< assembler.               */
+	const char* exec_path;                      /*!< processor.               */
+	const char* exec_options[MAX_EXEC_OPTIONS]; /*!< options of processor.    */
+	size_t      exec_options_amount;            /*!< amount of options.       */
+	size_t      runs;                           /*!< measured runs.           */
+	size_t      warmups;                        /*!< runs which aren't
+	                                                 measured.                */
+}
+bench_options_t;
+
+/*!
+ * Results of one workload.
+ */
+typedef struct bench_result_t_
+{
+	char               name[MAX_NAME_SIZE]; /*!< name of workload.            */
+	unsigned long long instructions;        /*!< executed instructions.       */
+	double*            samples;             /*!< wall time of runs in ns.     */
+	size_t             samples_amount;      /*!< amount of runs.              */
+	double             mean;                /*!< mean time in ns.             */
+	double             median;              /*!< median time in ns.           */
+	double             min;                 /*!< minimal time in ns.          */
+	double             variance;            /*!< sample variance in ns^2.     */
+	long               peak_rss;            /*!< peak resident set size
+	                                             of all runs in KiB.          */
+}
+bench_result_t;
+
+/*!
+ * Result of Welch's t-test.
+ */
+typedef struct welch_t_
+{
+	double t;       /*!< t statistic.                                        */
+	double df;      /*!< degrees of freedom.                                 */
+	double p_value; /*!< two-sided p-value.                                  */
+}
+welch_t;
+
+
+
+
+/*========================== Functions declaration ==========================*/
+
+/*!
+ * Assemble workload, count its instructions and measure its runs.
+ *
+ * @return success of this operation.
+ */
+bool bench_workload
+(
+	const bench_options_t* options,  /*!< [in]  options of benchmark.        */
+	const char*            asm_file, /*!< [in]  source of workload.          */
+	bench_result_t*        result    /*!< [out] results of workload.         */
+);
+
+/*!
+ * Compute statistics of result's samples.
+ */
+void bench_statistics
+(
+	bench_result_t* result /*!< [in,out] results of workload.                */
+);
+
+/*!
+ * Print results of benchmark as JSON.
+ */
+void bench_print_json
+(
+	FILE*                  output,  /*!< [in] output stream.                 */
+	const bench_options_t* options, /*!< [in] options of benchmark.          */
+	const bench_result_t*  results, /*!< [in] results of workloads.          */
+	size_t                 amount   /*!< [in] amount of workloads.           */
+);
+
+/*!
+ * Read results of workloads from JSON printed by bench_print_json().
+ *
+ * Only names and samples are read, other statistics are recomputed.
+ *
+ * @return array of results which must be freed by bench_free_results()
+ *         or NULL if file can't be read.
+ */
+bench_result_t* bench_read_json
+(
+	const char* fname, /*!< [in]  name of JSON file.                         */
+	size_t*     amount /*!< [out] amount of workloads.                       */
+);
+
+/*!
+ * Free results of workloads.
+ */
+void bench_free_results
+(
+	bench_result_t* results, /*!< [in] results of workloads.                 */
+	size_t          amount   /*!< [in] amount of workloads.                  */
+);
+
+/*!
+ * Compare mean times of two samples by Welch's t-test.
+ */
+welch_t welch_test
+(
+	const bench_result_t* a, /*!< [in] first results.                        */
+	const bench_result_t* b  /*!< [in] second results.                       */
+);
+
+/*!
+ * Print comparison of two benchmark results.
+ *
+ * @return amount of workloads which became significantly slower.
+ */
+size_t bench_compare
+(
+	FILE*                 output,     /*!< [in] output stream.               */
+	const bench_result_t* old,        /*!< [in] baseline results.            */
+	size_t                old_amount, /*!< [in] amount of baseline results.  */
+	const bench_result_t* new,        /*!< [in] compared results.            */
+	size_t                new_amount, /*!< [in] amount of compared results.  */
+	double                alpha       /*!< [in] significance level.          */
+);
+
+
+
+
+#endif // ifndef BENCH_H_
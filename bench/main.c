@@ -0,0 +1,220 @@
+/*!
+ * @file Main file for benchmark of the processor.
+ */
+
+#define _DEFAULT_SOURCE
+
+
+
+#include "bench.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <dirent.h>
+
+
+static bool parse_count (const char* str, size_t* count)
+{
+	char*              end = NULL;
+	unsigned long long val = strtoull(str, &end, 10);
+	if (end == str || *end != '\0' || val > SIZE_MAX / sizeof (double))
+		return false;
+
+	*count = (size_t) val;
+	return true;
+}
+
+
+static int compare_names (const void* a, const void* b)
+{
+	return strcmp(*(char* const*) a, *(char* const*) b);
+}
+
+
+/*
+ * Add all .asm files of directory to the list of workloads.
+ */
+static bool add_dir (const char* dir, char*** files, size_t* amount)
+{
+	DIR* stream = opendir(dir);
+	if (!stream)
+		return false;
+
+	size_t         first = *amount;
+	struct dirent* entry = NULL;
+	while ((entry = readdir(stream)) != NULL)
+	{
+		const char* ext = strrchr(entry->d_name, '.');
+		if (!ext || strcmp(ext, ".asm") != 0)
+			continue;
+
+		char** new_files = (char**)
+			realloc(*files, (*amount + 1) * sizeof *new_files);
+		char*  path      = (char*) malloc(strlen(dir) + strlen(entry->d_name) + 2);
+		if (!new_files || !path)
+		{
+			free(path);
+			closedir(stream);
+			return false;
+		}
+
+		sprintf(path, "%s/%s", dir, entry->d_name);
+		*files = new_files;
+		(*files)[(*amount)++] = path;
+	}
+
+	closedir(stream);
+	qsort(*files + first, *amount - first, sizeof **files, compare_names);
+	return true;
+}
+
+
+static int compare (const char* old_fname, const char* new_fname, double alpha)
+{
+	size_t          old_amount = 0;
+	size_t          new_amount = 0;
+	bench_result_t* old = bench_read_json(old_fname, &old_amount);
+	bench_result_t* new = bench_read_json(new_fname, &new_amount);
+
+	int status = 1;
+	if (!old || !new)
+		fputs("Results cannot be read.\n", stderr);
+	else
+		status = bench_compare(stdout, old, old_amount, new, new_amount,
+		                       alpha) ? 1 : 0;
+
+	bench_free_results(old, old_amount);
+	bench_free_results(new, new_amount);
+	return status;
+}
+
+
+int main (int argc, char* argv[])
+{
+	bench_options_t options =
+	{
+		.asm_path            = "./pegas_asm",
+		.exec_path           = "./pegas_exec",
+		.exec_options_amount = 0,
+		.runs                = 10,
+		.warmups             = 1,
+	};
+
+	const char* output_fname = NULL;
+	bool        compare_mode = false;
+	double      alpha        = 0.05;
+
+	char** files  = NULL;
+	size_t amount = 0;
+	for (int i = 1; i < argc; ++i)
+	{
+		const char* arg     = argv[i];
+		bool        correct = true;
+
+		if (strncmp(arg, "--", 2) != 0)
+		{
+			char** new_files = (char**)
+				realloc(files, (amount + 1) * sizeof *new_files);
+			if (!new_files)
+				return 1;
+
+			files = new_files;
+			files[amount++] = strdup(arg);
+		}
+		else if (strncmp(arg, "--runs=", 7) == 0)
+			correct = parse_count(arg + 7, &options.runs) && options.runs > 0;
+		else if (strncmp(arg, "--warmups=", 10) == 0)
+			correct = parse_count(arg + 10, &options.warmups);
+		else if (strncmp(arg, "--asm=", 6) == 0)
+			options.asm_path = arg + 6;
+		else if (strncmp(arg, "--exec=", 7) == 0)
+			options.exec_path = arg + 7;
+		else if (strncmp(arg, "--exec-option=", 14) == 0)
+		{
+			correct = options.exec_options_amount < MAX_EXEC_OPTIONS;
+			if (correct)
+				options.exec_options[options.exec_options_amount++] = arg + 14;
+		}
+		else if (strncmp(arg, "--output=", 9) == 0)
+			output_fname = arg + 9;
+		else if (strcmp(arg, "--compare") == 0)
+			compare_mode = true;
+		else if (strncmp(arg, "--alpha=", 8) == 0)
+		{
+			alpha   = atof(arg + 8);
+			correct = alpha > 0 && alpha < 1;
+		}
+		else
+			correct = false;
+
+		if (!correct)
+		{
+			fprintf(stderr, "Unknown option: %s\n", arg);
+			return 1;
+		}
+	}
+
+	int status = 0;
+	if (compare_mode)
+	{
+		if (amount != 2)
+		{
+			fputs("Wrong amount of arguments.\n", stderr);
+			return 1;
+		}
+
+		status = compare(files[0], files[1], alpha);
+	}
+	else
+	{
+		if (amount == 0
+		    && (!add_dir(EXAMPLES_DIR, &files, &amount)
+		        || !add_dir(WORKLOADS_DIR, &files, &amount)))
+		{
+			fputs("Workloads cannot be found.\n", stderr);
+			return 1;
+		}
+
+		bench_result_t* results = (bench_result_t*)
+			calloc(amount ? amount : 1, sizeof *results);
+		if (!results)
+			return 1;
+
+		size_t done = 0;
+		for (size_t i = 0; i < amount; ++i)
+		{
+			fprintf(stderr, "Running %s...\n", files[i]);
+			if (bench_workload(&options, files[i], results + done))
+				++done;
+			else
+			{
+				free(results[done].samples);
+				results[done].samples = NULL;
+				status = 1;
+			}
+		}
+
+		FILE* output = output_fname ? fopen(output_fname, "w") : stdout;
+		if (!output)
+		{
+			fputs("Output file cannot be opened.\n", stderr);
+			status = 1;
+		}
+		else
+		{
+			bench_print_json(output, &options, results, done);
+			if (output != stdout)
+				fclose(output);
+		}
+
+		bench_free_results(results, done);
+	}
+
+	for (size_t i = 0; i < amount; ++i)
+		free(files[i]);
+
+	free(files);
+	return status;
+}
@@ -0,0 +1,33 @@
+; Tight arithmetic loop: register traffic and ALU commands only.
+; Runs 5000000 iterations and prints the last computed value.
+
+	push	0
+	pop		ax
+
+LOOP:
+	push	ax
+	push	ax
+	push	3
+	mul
+	sub
+	pop		bx
+
+	push	2
+	push	bx
+	div
+	push	7
+	add
+	pop		cx
+
+	push	ax
+	push	1
+	add
+	pop		ax
+
+	push	ax
+	push	5000000
+	ja		LOOP
+
+	push	cx
+	out
+	hit
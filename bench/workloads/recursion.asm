@@ -0,0 +1,41 @@
+; Deep recursion: DEPTH(n) = DEPTH(n - 1) + 1 with n = 200000,
+; repeated 20 times. Stresses call, ret and the operand stack.
+
+	push	0
+	pop		dx
+
+REPEAT:
+	push	200000
+	call	DEPTH
+	pop		cx
+
+	push	dx
+	push	1
+	add
+	pop		dx
+
+	push	dx
+	push	20
+	ja		REPEAT
+
+	push	cx
+	out
+	hit
+
+DEPTH:
+	pop		ax
+	push	ax
+	push	0
+	je		.DEPTH_ZERO
+
+	push	1
+	push	ax
+	sub
+	call	DEPTH
+	push	1
+	add
+	ret
+
+.DEPTH_ZERO:
+	push	0
+	ret
@@ -0,0 +1,37 @@
+; Video fill: writes every cell of video memory with a moving
+; pattern and redraws the frame, 30 frames in total.
+
+	push	0
+	pop		dx
+
+FRAME:
+	push	0
+	pop		ax
+
+.FILL_LOOP:
+	push	ax
+	push	dx
+	add
+	pop		[ax]
+
+	push	ax
+	push	1
+	add
+	pop		ax
+
+	push	ax
+	push	65536
+	ja		.FILL_LOOP
+
+	drw
+
+	push	dx
+	push	1
+	add
+	pop		dx
+
+	push	dx
+	push	30
+	ja		FRAME
+
+	hit
@@ -105,6 +105,17 @@ typedef enum commands_t_
 commands_t;
 #undef DEF_CMD
 
+/*!
+ * Description of command which is shared by assembler and disassembler.
+ */
+typedef struct cmd_info_t_
+{
+	const char* name;     /*!< mnemonic or NULL if opcode isn't used.        */
+	size_t      name_len; /*!< length of mnemonic.                           */
+	arg_t       arg;      /*!< type of command's argument.                   */
+}
+cmd_info_t;
+
 
 
 
@@ -118,6 +129,17 @@ extern const char*       ASM_EXT;
 extern const size_t      EXEC_EXT_SIZE;
 extern const size_t      ASM_EXT_SIZE;
 
+/*!
+ * Amount of opcodes. Bits REG_ARG and ADDR_ARG of instruction
+ * aren't part of its opcode.
+ */
+#define CMD_AMOUNT (size_t) REG_ARG
+
+/*!
+ * Commands indexed by opcode. They are generated from DEF_CMD.
+ */
+extern const cmd_info_t CMD_INFO[CMD_AMOUNT];
+
 /*!
  * The number of registers.
  *
@@ -39,3 +39,14 @@ const char* ASM_EXT = "asm";
  * Assembly file extension's string length.
  */
 const size_t ASM_EXT_SIZE = 3;
+
+/*!
+ * Commands indexed by opcode.
+ */
+#define DEF_CMD(CMD_, NUM_, ARG_, ...)                                        \
+	[NUM_] = { #CMD_, sizeof #CMD_ - 1, ARG_ },
+const cmd_info_t CMD_INFO[CMD_AMOUNT] =
+{
+	#include "DEF_CMD" /* e.g. [2] = { "jmp", 3, LABEL_ARG },                */
+};
+#undef DEF_CMD
@@ -90,10 +90,11 @@ int check_signature (disasm_state_t disasm)
 	if (disasm->instr_size < sizeof SIGNATURE + sizeof VERSION)
 		return 0;
 
-	if (*(signature_t*) disasm->instructions != SIGNATURE)
+	if (*(const signature_t*) disasm->instructions != SIGNATURE)
 		return 0;
 
-	version_t version = *(version_t*) (disasm->instructions + sizeof SIGNATURE);
+	version_t version = *(const version_t*) (disasm->instructions
+	                                         + sizeof SIGNATURE);
 	if (version != VERSION)
 	{
 		printf("Incompatible file version: %d > %d\n", version, VERSION);
@@ -121,8 +122,8 @@ disasm_state_t disasm_init (FILE* output, FILE* input)
 	disasm->ip = 0;
 	disasm->error = NO_PROC_ERR;
 	
-	disasm->instructions = (unsigned char*) read_file(input,
-	                                                  &disasm->instr_size);
+	disasm->instructions = (const unsigned char*)
+		map_file(input, &disasm->instr_size, &disasm->instr_mapped);
 	if (!disasm->instructions)
 		return disasm_delete(disasm);
 
@@ -141,8 +142,8 @@ disasm_state_t disasm_delete (disasm_state_t disasm)
 	if_log (is_bad_mem(disasm, sizeof *disasm), WARNING,
 		return NULL;)
 
-	if (disasm->instructions)
-		free(disasm->instructions);
+	unmap_file((const char*) disasm->instructions, disasm->instr_size,
+	           disasm->instr_mapped);
 
 	if (disasm->labels)
 		free(disasm->labels);
@@ -152,17 +153,6 @@ disasm_state_t disasm_delete (disasm_state_t disasm)
 }
 
 
-#define DEF_CMD(NAME_, NUM_, ARGS_, ...)                                      \
-	case NUM_:                                                                \
-		fputs("\t"#NAME_, disasm->output);                                        \
-		if (!print_arg(disasm, instruction, ARGS_))                           \
-		{                                                                     \
-			disasm->error = WRONG_ARG;                                        \
-			print_error(WRONG_ARG, #NAME_);                                   \
-			return 0;                                                         \
-		}                                                                     \
-		break;
-
 int disasm_process (disasm_state_t disasm)
 {
 	if_log (is_bad_mem(disasm, sizeof *disasm), ERROR,
@@ -176,20 +166,27 @@ int disasm_process (disasm_state_t disasm)
 
 	unsigned char instruction = disasm->instructions[disasm->ip++];
 	
-	switch (instruction & (~(unsigned char) ADDR_ARG) & (~(unsigned char) REG_ARG))
+	const cmd_info_t* cmd = CMD_INFO + (instruction & (~(unsigned char) ADDR_ARG)
+	                                                & (~(unsigned char) REG_ARG));
+	if (!cmd->name)
 	{
-		#include "../DEF_CMD"
-		default:
-			disasm->error = UNKNOWN_INSTR;
-			print_error(UNKNOWN_INSTR, "");
-			return 0;
+		disasm->error = UNKNOWN_INSTR;
+		print_error(UNKNOWN_INSTR, "");
+		return 0;
+	}
+
+	fputc('\t', disasm->output);
+	fputs(cmd->name, disasm->output);
+	if (!print_arg(disasm, instruction, cmd->arg))
+	{
+		disasm->error = WRONG_ARG;
+		print_error(WRONG_ARG, cmd->name);
+		return 0;
 	}
 
 	return 1;
 }
 
-#undef DEF_CMD
-
 
 int print_arg (disasm_state_t disasm, char instr, arg_t arg_type)
 {
@@ -295,18 +292,6 @@ int print_mem_arg (disasm_state_t disasm, char instr)
 }
 
 
-#define DEF_CMD(NAME_, NUM_, ARG_TYPE_, ...)                                  \
-	case NUM_:                                                                \
-		if (ARG_TYPE_ == LABEL_ARG)                                           \
-		{                                                                     \
-			if (!update_label(disasm, ip))                                    \
-				return 0;                                                     \
-			ip += sizeof *disasm->labels;                                     \
-		}                                                                     \
-		else if (ARG_TYPE_ == MEMORY_ARG)                                     \
-			ip += arg_size(instruction);                                      \
-		break;
-
 int get_labels (disasm_state_t disasm)
 {
 	if_log (is_bad_mem(disasm, sizeof *disasm), ERROR,
@@ -316,17 +301,27 @@ int get_labels (disasm_state_t disasm)
 	while (ip < disasm->instr_size)
 	{
 		unsigned char instruction = disasm->instructions[ip++];
-		switch (instruction & ~REG_ARG & ~ADDR_ARG)
+		switch (CMD_INFO[instruction & ~REG_ARG & ~ADDR_ARG].arg)
 		{
-			#include "../DEF_CMD"
+			case LABEL_ARG:
+				if (!update_label(disasm, ip))
+					return 0;
+				ip += sizeof *disasm->labels;
+				break;
+
+			case MEMORY_ARG:
+				ip += arg_size(instruction);
+				break;
+
+			case NO_ARGS:
+			default:
+				break;
 		}
 	}
 
 	return 1;
 }
 
-#undef DEF_CMD
-
 
 size_t arg_size (unsigned char instr)
 {
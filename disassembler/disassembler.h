@@ -29,8 +29,10 @@
 typedef struct disasm_state_t_
 {
 	addr_t         ip;              /*!< instruction pointer.                */
-	unsigned char* instructions;    /*!< array with instructions.            */
+	const unsigned char* instructions; /*!< array with instructions.         */
 	size_t         instr_size;      /*!< size of array with instructions.    */
+	bool           instr_mapped;    /*!< instructions are mapped from
+	                                     input file.                         */
 	proc_error_t   error;           /*!< error code which happened during 
 	                                     the execution.                      */
 	addr_t*        labels;          /*!< sorted array with labels.           */
@@ -70,5 +70,29 @@ void print_error (proc_error_t err, const char *str)
 		case WRONG_SIGNATURE:
 			print_err_text("Wrong pegas signature.", str);
 			break;
+
+		case STACK_OVERFLOW:
+			print_err_text("Stack overflow.", str);
+			break;
+
+		case STACK_UNDERFLOW:
+			print_err_text("Stack underflow.", str);
+			break;
+
+		case WRONG_REG:
+			print_err_text("Wrong register index ", str);
+			break;
+
+		case MEM_FAULT:
+			print_err_text("Memory access out of bounds.", str);
+			break;
+
+		case READ_ERR:
+			print_err_text("Input can't be read.", str);
+			break;
+
+		case WRITE_ERR:
+			print_err_text("Output can't be written.", str);
+			break;
 	}
 }
@@ -30,7 +30,13 @@ typedef enum proc_error_t_
 	MISSING_ARG     = 5, /*!< argument doesn't exists.                        */
 	UNKNOWN_LABEL   = 6, /*!< unknown label.                                 */
 	UNKNOWN_INSTR   = 7, /*!< unknown instruction number.                    */
-	WRONG_SIGNATURE = 8  /*!< wring pegas signature.                         */
+	WRONG_SIGNATURE = 8, /*!< wring pegas signature.                         */
+	STACK_OVERFLOW  = 9, /*!< processor's stack overflow.                    */
+	STACK_UNDERFLOW = 10, /*!< pop from empty processor's stack.             */
+	WRONG_REG       = 11, /*!< register index is out of range.               */
+	MEM_FAULT       = 12, /*!< memory access out of bounds in sandbox.       */
+	READ_ERR        = 13, /*!< input can't be read.                          */
+	WRITE_ERR       = 14  /*!< output can't be written.                      */
 }
 proc_error_t;
 
@@ -16,6 +16,15 @@
 
 
 
+/*======================= Constants ======================*/
+
+
+static const uint64_t FNV_OFFSET_BASIS = 14695981039346656037ULL;
+static const uint64_t FNV_PRIME        = 1099511628211ULL;
+
+
+
+
 /*=================== Global functions ===================*/
 
 
@@ -42,3 +51,24 @@ uint64_t pearson_hash64 (const void* data, size_t len)
 
 	return hash64;
 }
+
+
+uint64_t fnv1a_hash64 (const void* data, size_t len)
+{
+	if (!len)
+		return FNV_OFFSET_BASIS;
+
+	if_log (is_bad_mem(data, len), ERROR,
+		return 0;)
+
+	uint64_t hash64 = FNV_OFFSET_BASIS;
+	const unsigned char* uchar_data = (const unsigned char*) data;
+
+	for (size_t i = 0; i < len; ++i)
+	{
+		hash64 ^= uchar_data[i];
+		hash64 *= FNV_PRIME;
+	}
+
+	return hash64;
+}
@@ -38,4 +38,16 @@
 uint64_t pearson_hash64 (const void* data, size_t len);
 
 
+/*! This function implements the 64-bit FNV-1a hashing
+ *  algorithm. It processes one byte per multiplication,
+ *  so it suits short keys such as names.
+ *
+ *  @param[in] data - pointer to hashing memory.
+ *  @param[in] len  - length of hashing memory.
+ *
+ *  @return hash value.
+ */
+uint64_t fnv1a_hash64 (const void* data, size_t len);
+
+
 #endif
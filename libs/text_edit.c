@@ -4,6 +4,7 @@
  * work with files and strings.
  */
 
+#define _DEFAULT_SOURCE
 
 
 
@@ -17,6 +18,48 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+
+
+
+/*============================= Static functions ============================*/
+
+
+/*
+ * Read file which doesn't support fseek() (e.g. pipe) by chunks.
+ */
+static char* read_stream (FILE* in, size_t* size)
+{
+	size_t len      = 0;
+	size_t capacity = 0;
+	char*  str      = NULL;
+
+	do
+	{
+		if (len + 1 >= capacity)
+		{
+			capacity = capacity * 2 + BUFSIZ;
+			char* new_str = (char*) realloc(str, capacity);
+			if (!new_str)
+			{
+				free(str);
+				*size = 0;
+				return NULL;
+			}
+
+			str = new_str;
+		}
+
+		len += fread(str + len, sizeof *str, capacity - len - 1, in);
+	}
+	while (!feof(in) && !ferror(in));
+
+	str[len] = '\0';
+	*size    = len;
+	return str;
+}
 
 
 
@@ -59,9 +102,12 @@ char* read_file (FILE* in, size_t* size)
 	if_log (is_bad_mem(in, sizeof *in), ERROR,
 		return NULL;)
 
-	fseek(in, 0, SEEK_END);
-	size_t len = ftell(in);
-	fseek(in, 0, SEEK_SET);
+	long end = -1;
+	if (fseek(in, 0, SEEK_END) != 0 || (end = ftell(in)) < 0
+	    || fseek(in, 0, SEEK_SET) != 0)
+		return read_stream(in, size);
+
+	size_t len = (size_t) end;
 
 	char* str = (char*) calloc(len + 1, sizeof *str);
 	if (!str)
@@ -74,3 +120,43 @@ char* read_file (FILE* in, size_t* size)
 	*size = len;
 	return str;
 }
+
+
+const char* map_file (FILE* in, size_t* size, bool* mapped)
+{
+	if_log (is_bad_mem(in, sizeof *in), ERROR,
+		return NULL;)
+
+	if_log (is_bad_mem(mapped, sizeof *mapped), ERROR,
+		return NULL;)
+
+	struct stat info = {};
+	*mapped = false;
+
+	if (fstat(fileno(in), &info) == 0 && S_ISREG(info.st_mode)
+	    && info.st_size > 0)
+	{
+		void* data = mmap(NULL, (size_t) info.st_size, PROT_READ, MAP_PRIVATE,
+		                  fileno(in), 0);
+		if (data != MAP_FAILED)
+		{
+			*size   = (size_t) info.st_size;
+			*mapped = true;
+			return (const char*) data;
+		}
+	}
+
+	return read_file(in, size);
+}
+
+
+void unmap_file (const char* data, size_t size, bool mapped)
+{
+	if (!data)
+		return;
+
+	if (mapped)
+		munmap((void*) data, size);
+	else
+		free((void*) data);
+}
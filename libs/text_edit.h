@@ -13,6 +13,7 @@
 
 
 #include <stdio.h>
+#include <stdbool.h>
 
 
 
@@ -54,6 +55,32 @@ char* read_file
 	                        readed bytes amount if success else 0.           */
 );
 
+/*!
+ * Map file into memory for reading without copying it.
+ *
+ * Files which can't be mapped (pipes, empty files) are read
+ * by read_file().
+ *
+ * @return contents of file which must be released by unmap_file()
+ *         or NULL if an error occured.
+ */
+const char* map_file
+(
+	FILE*   in,     /*!< [in]  input file.                                   */
+	size_t* size,   /*!< [out] size of file if success else 0.               */
+	bool*   mapped  /*!< [out] contents are mapped, not read.                */
+);
+
+/*!
+ * Release contents of file returned by map_file().
+ */
+void unmap_file
+(
+	const char* data,  /*!< [in] contents of file.                           */
+	size_t      size,  /*!< [in] size of file.                               */
+	bool        mapped /*!< [in] contents are mapped.                        */
+);
+
 
 
 
@@ -0,0 +1,404 @@
+/*!
+ * @file
+ * @brief Static analysis of operand stack depth of decoded programs.
+ *
+ * Functions are code reachable from the program's beginning or from
+ * call targets until ret. Each function is walked with depth relative
+ * to its beginning, and call is replaced by summary of called function.
+ * Summaries are recomputed until they stop changing. Ranges which keep
+ * growing (loops and recursion) are widened to infinity.
+ */
+
+
+
+/*============================ Including headers ============================*/
+
+
+#include "analysis.h"
+#include "../libs/others.h"
+#include "../libs/logging.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+
+
+
+
+/*======================== Macros & static functions ========================*/
+
+
+/*
+ * Stack effects of commands. Division pushes nothing if divisor is zero
+ * but it isn't taken into account (see analyze_stack_depth()).
+ * out only reads the top value.
+ */
+static const stack_effect_t EFFECTS[UCHAR_MAX + 1] =
+{
+	[cmd_je]   = { 2, 2, 0 },
+	[cmd_jne]  = { 2, 2, 0 },
+	[cmd_jb]   = { 2, 2, 0 },
+	[cmd_jnb]  = { 2, 2, 0 },
+	[cmd_ja]   = { 2, 2, 0 },
+	[cmd_jna]  = { 2, 2, 0 },
+	[cmd_push] = { 0, 0, 1 },
+	[cmd_pop]  = { 1, 1, 0 },
+	[cmd_add]  = { 2, 2, 1 },
+	[cmd_sub]  = { 2, 2, 1 },
+	[cmd_mul]  = { 2, 2, 1 },
+	[cmd_div]  = { 2, 2, 1 },
+	[cmd_sqrt] = { 1, 1, 1 },
+	[cmd_out]  = { 1, 0, 0 },
+};
+
+
+static depth_t depth_add (depth_t a, depth_t b)
+{
+	depth_t sum = a + b;
+	if (sum > DEPTH_INF)
+		return DEPTH_INF;
+
+	if (sum < -DEPTH_INF)
+		return -DEPTH_INF;
+
+	return sum;
+}
+
+
+static depth_t depth_max (depth_t a, depth_t b)
+{
+	return (a > b) ? a : b;
+}
+
+
+static depth_t depth_min (depth_t a, depth_t b)
+{
+	return (a < b) ? a : b;
+}
+
+
+static depth_range_t range_join (depth_range_t a, depth_range_t b)
+{
+	depth_range_t joined = { depth_min(a.lo, b.lo), depth_max(a.hi, b.hi) };
+	return joined;
+}
+
+
+static depth_range_t range_widen (depth_range_t old, depth_range_t joined,
+                                  depth_t floor)
+{
+	if (joined.lo < old.lo)
+		joined.lo = floor;
+
+	if (joined.hi > old.hi)
+		joined.hi = DEPTH_INF;
+
+	return joined;
+}
+
+
+static bool range_equal (depth_range_t a, depth_range_t b)
+{
+	return a.lo == b.lo && a.hi == b.hi;
+}
+
+
+static void flow (analysis_t* an, size_t to, depth_range_t range)
+{
+	/* with absolute depths execution stops on underflow, so the depth
+	 * after an underflowing instruction is clamped to 0                */
+	range.lo = depth_max(range.lo, an->floor);
+	range.hi = depth_max(range.hi, an->floor);
+
+	if (an->stamps[to] != an->stamp)
+	{
+		an->stamps[to]  = an->stamp;
+		an->growths[to] = 0;
+		an->ranges[to]  = range;
+	}
+	else
+	{
+		depth_range_t joined = range_join(an->ranges[to], range);
+		if (range_equal(joined, an->ranges[to]))
+			return;
+
+		if (++an->growths[to] > WIDEN_LIMIT)
+			joined = range_widen(an->ranges[to], joined, an->floor);
+
+		an->ranges[to] = joined;
+	}
+
+	if (!an->queued[to])
+	{
+		an->queued[to]                    = true;
+		an->worklist[an->worklist_size++] = to;
+	}
+}
+
+
+static depth_t instr_need (const analysis_t* an, const instr_t* instr)
+{
+	if (instr->cmd == cmd_call)
+		return an->funcs[an->func_id[instr->target]].need;
+
+	return EFFECTS[instr->cmd].need;
+}
+
+
+/*
+ * Walk function which begins at entry and compute its summary.
+ * Depths before walked instructions stay in an->ranges.
+ */
+static func_summary_t walk_function (analysis_t* an, size_t entry)
+{
+	func_summary_t summary =
+	{
+		.need    = 0,
+		.peak    = 0,
+		.effect  = { DEPTH_INF, -DEPTH_INF },
+		.returns = false,
+	};
+
+	const instr_t* code = an->proc->code;
+	size_t         size = an->proc->code_size;
+
+	++an->stamp;
+	an->worklist_size = 0;
+	flow(an, entry, (depth_range_t) { 0, 0 });
+
+	while (an->worklist_size > 0)
+	{
+		size_t i = an->worklist[--an->worklist_size];
+		an->queued[i] = false;
+
+		if (i >= size)
+			continue;
+
+		const instr_t*        instr  = code + i;
+		const func_summary_t* callee = NULL;
+		depth_range_t         range  = an->ranges[i];
+		stack_effect_t        effect = EFFECTS[instr->cmd];
+
+		if (instr->cmd == cmd_call)
+			callee = an->funcs + an->func_id[instr->target];
+
+		summary.need = depth_max(summary.need,
+		                         depth_add(instr_need(an, instr), -range.lo));
+
+		depth_range_t after =
+		{
+			depth_add(range.lo, effect.pushes - effect.pops),
+			depth_add(range.hi, effect.pushes - effect.pops),
+		};
+
+		switch (instr->cmd)
+		{
+			case cmd_hit:
+				break;
+
+			case cmd_ret:
+				summary.effect  = range_join(summary.effect, range);
+				summary.returns = true;
+				break;
+
+			case cmd_call:
+				summary.peak = depth_max(summary.peak,
+				                         depth_add(range.hi, callee->peak));
+				if (!callee->returns)
+					break;
+
+				after.lo = depth_add(range.lo, callee->effect.lo);
+				after.hi = depth_add(range.hi, callee->effect.hi);
+				flow(an, i + 1, after);
+				break;
+
+			case cmd_jmp:
+				flow(an, instr->target, after);
+				break;
+
+			case cmd_je:  case cmd_jne:
+			case cmd_jb:  case cmd_jnb:
+			case cmd_ja:  case cmd_jna:
+				flow(an, instr->target, after);
+				flow(an, i + 1, after);
+				break;
+
+			default:
+				flow(an, i + 1, after);
+				break;
+		}
+
+		summary.peak = depth_max(summary.peak, after.hi);
+	}
+
+	return summary;
+}
+
+
+/*
+ * Report instructions of the last walked function which may pop
+ * from empty stack.
+ */
+static void report_underflows (const analysis_t* an)
+{
+	const instr_t* code = an->proc->code;
+
+	for (size_t i = 0; i < an->proc->code_size; ++i)
+	{
+		if (an->stamps[i] != an->stamp)
+			continue;
+
+		depth_t need = instr_need(an, code + i);
+		if (an->ranges[i].lo < 0 || depth_add(need, -an->ranges[i].lo) <= 0)
+			continue;
+
+		char str[MAX_TOKEN_SIZE * 2];
+		if (code[i].cmd == cmd_call && need >= DEPTH_INF)
+			sprintf(str, " It is possible in function called at instruction"
+			             " %zu which needs an unbounded number of values.",
+			        i);
+		else if (code[i].cmd == cmd_call)
+			sprintf(str, " It is possible in function called at instruction"
+			             " %zu which needs %lld values.", i, need);
+		else
+			sprintf(str, " It is possible at instruction %zu.", i);
+
+		print_error(STACK_UNDERFLOW, str);
+	}
+}
+
+
+static bool summary_equal (const func_summary_t* a, const func_summary_t* b)
+{
+	return a->need == b->need && a->peak == b->peak
+	       && a->returns == b->returns
+	       && (!a->returns || range_equal(a->effect, b->effect));
+}
+
+
+static void summary_widen (const func_summary_t* old, func_summary_t* new)
+{
+	if (new->need > old->need)
+		new->need = DEPTH_INF;
+
+	if (new->peak > old->peak)
+		new->peak = DEPTH_INF;
+
+	if (new->returns && old->returns)
+		new->effect = range_widen(old->effect, new->effect, -DEPTH_INF);
+}
+
+
+static void analysis_delete (analysis_t* an)
+{
+	free(an->func_id);
+	free(an->funcs);
+	free(an->ranges);
+	free(an->stamps);
+	free(an->growths);
+	free(an->worklist);
+	free(an->queued);
+}
+
+
+static bool analysis_init (analysis_t* an, proc_state_t proc)
+{
+	size_t size = proc->code_size + 1;
+
+	an->proc     = proc;
+	an->stamp    = 0;
+	an->floor    = -DEPTH_INF;
+	an->func_id  = (size_t*)         calloc(size,     sizeof *an->func_id);
+	an->funcs    = (func_summary_t*) calloc(size,     sizeof *an->funcs);
+	an->ranges   = (depth_range_t*)  calloc(size,     sizeof *an->ranges);
+	an->stamps   = (size_t*)         calloc(size,     sizeof *an->stamps);
+	an->growths  = (size_t*)         calloc(size,     sizeof *an->growths);
+	an->worklist = (size_t*)         calloc(size + 1, sizeof *an->worklist);
+	an->queued   = (bool*)           calloc(size,     sizeof *an->queued);
+
+	if (!an->func_id || !an->funcs || !an->ranges || !an->stamps
+	    || !an->growths || !an->worklist || !an->queued)
+	{
+		analysis_delete(an);
+		return false;
+	}
+
+	for (size_t i = 0; i < size; ++i)
+		an->func_id[i] = SIZE_MAX;
+
+	an->func_id[0] = 0;
+	an->funcs_num  = 1;
+
+	for (size_t i = 0; i < proc->code_size; ++i)
+	{
+		addr_t target = proc->code[i].target;
+		if (proc->code[i].cmd == cmd_call && an->func_id[target] == SIZE_MAX)
+			an->func_id[target] = an->funcs_num++;
+	}
+
+	return true;
+}
+
+
+
+
+/*========================= Functions implementation ========================*/
+
+
+int analyze_stack_depth (proc_state_t proc, stack_depth_t* result)
+{
+	if_log (is_bad_mem(proc, sizeof *proc), ERROR,
+		return 0;)
+
+	if_log (is_bad_mem(result, sizeof *result), ERROR,
+		return 0;)
+
+	analysis_t an = {};
+	if (!analysis_init(&an, proc))
+	{
+		proc->error = ALLOC_ERR;
+		print_error(ALLOC_ERR, "stack analysis");
+		return 0;
+	}
+
+	for (size_t i = 0; i < an.funcs_num; ++i)
+		an.funcs[i].effect = (depth_range_t) { DEPTH_INF, -DEPTH_INF };
+
+	bool changed = true;
+	for (size_t round = 0; changed; ++round)
+	{
+		changed = false;
+		for (size_t entry = 0; entry < proc->code_size; ++entry)
+		{
+			if (an.func_id[entry] == SIZE_MAX)
+				continue;
+
+			func_summary_t* old     = an.funcs + an.func_id[entry];
+			func_summary_t  summary = walk_function(&an, entry);
+			if (round >= WIDEN_LIMIT)
+				summary_widen(old, &summary);
+
+			if (!summary_equal(old, &summary))
+			{
+				*old    = summary;
+				changed = true;
+			}
+		}
+	}
+
+	const func_summary_t* main_func = an.funcs;
+	if (proc->code_size > 0 && main_func->need > 0)
+	{
+		an.floor = 0;
+		walk_function(&an, 0);
+		report_underflows(&an);
+	}
+
+	result->safe_pops = main_func->need <= 0;
+	result->bounded   = main_func->peak < DEPTH_INF;
+	result->max_depth = result->bounded ? (size_t) main_func->peak : SIZE_MAX;
+
+	analysis_delete(&an);
+	return 1;
+}
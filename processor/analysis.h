@@ -0,0 +1,146 @@
+/*!
+ * @file
+ * @brief Header for static analysis of operand stack depth.
+ */
+
+#ifndef ANALYSIS_H_
+#define ANALYSIS_H_
+
+
+
+
+/*============================ Including headers ============================*/
+
+
+#include "processor.h"
+
+#include <stddef.h>
+#include <stdbool.h>
+#include <limits.h>
+
+
+
+
+/*=========================== Constants declaration =========================*/
+
+/*!
+ * Unbounded stack depth.
+ */
+#define DEPTH_INF (depth_t) (LLONG_MAX / 4)
+
+/*!
+ * Amount of growths of depth range after which it is widened to infinity.
+ */
+#define WIDEN_LIMIT (size_t) 3
+
+
+
+
+/*============================ Types declaration ============================*/
+
+/*!
+ * Stack depth relative to some point of the program.
+ */
+typedef long long depth_t;
+
+/*!
+ * Range of possible stack depths.
+ *
+ * Range is empty if lo > hi.
+ */
+typedef struct depth_range_t_
+{
+	depth_t lo; /*!< minimal depth.                                          */
+	depth_t hi; /*!< maximal depth.                                          */
+}
+depth_range_t;
+
+/*!
+ * Effect of command on operand stack.
+ */
+typedef struct stack_effect_t_
+{
+	unsigned char need;   /*!< values which must be on the stack.            */
+	unsigned char pops;   /*!< values which are removed.                     */
+	unsigned char pushes; /*!< values which are added.                       */
+}
+stack_effect_t;
+
+/*!
+ * Effect of function (code from call target to ret) on operand stack.
+ *
+ * All depths are relative to the depth at the call.
+ */
+typedef struct func_summary_t_
+{
+	depth_t       need;    /*!< values which must be on the stack
+	                            before the call.                             */
+	depth_t       peak;    /*!< maximal depth during the call.               */
+	depth_range_t effect;  /*!< depth after return.                          */
+	bool          returns; /*!< function can return.                         */
+}
+func_summary_t;
+
+/*!
+ * State of stack depth analysis.
+ */
+typedef struct analysis_t_
+{
+	proc_state_t    proc;          /*!< analysed program.                    */
+	size_t*         func_id;       /*!< index of function which starts at
+	                                    instruction or SIZE_MAX.             */
+	func_summary_t* funcs;         /*!< summaries of functions.              */
+	size_t          funcs_num;     /*!< amount of functions.                 */
+	depth_range_t*  ranges;        /*!< depths before instructions.          */
+	size_t*         stamps;        /*!< number of walk which assigned range. */
+	size_t*         growths;       /*!< amount of growths of range.          */
+	size_t*         worklist;      /*!< instructions which must be walked.   */
+	size_t          worklist_size; /*!< amount of instructions in worklist.  */
+	bool*           queued;        /*!< instruction is in worklist.          */
+	size_t          stamp;         /*!< number of current walk.              */
+	depth_t         floor;         /*!< the lowest depth after instruction:
+	                                    0 if depths are absolute, else
+	                                    -DEPTH_INF.                          */
+}
+analysis_t;
+
+/*!
+ * Result of stack depth analysis.
+ */
+typedef struct stack_depth_t_
+{
+	bool   safe_pops; /*!< stack can't underflow.                            */
+	bool   bounded;   /*!< stack depth has upper bound.                      */
+	size_t max_depth; /*!< upper bound of stack depth if it exists.          */
+}
+stack_depth_t;
+
+
+
+
+/*========================== Functions declaration ==========================*/
+
+/*!
+ * Compute bounds of operand stack depth of decoded program.
+ *
+ * Calls are analysed using summaries of called functions, so the
+ * program's depth is known after every return. Instructions which
+ * may pop from empty stack are reported in stderr.
+ *
+ * Division is assumed to push its result. Division by zero breaks
+ * the bounds, so it is reported by STACK_UNPROVEN in DEF_CMD.
+ *
+ * @note program mustn't contain superinstructions.
+ *
+ * @return success of this operation.
+ */
+int analyze_stack_depth
+(
+	proc_state_t   proc,  /*!< [in]  processor state with decoded program.   */
+	stack_depth_t* result /*!< [out] bounds of stack depth.                  */
+);
+
+
+
+
+#endif // ifndef ANALYSIS_H_
@@ -0,0 +1,219 @@
+/*!
+ * @file
+ * @brief Capturing frames of video memory without display.
+ */
+
+#define _DEFAULT_SOURCE
+
+
+
+/*============================ Including headers ============================*/
+
+
+#include "capture.h"
+#include "../libs/others.h"
+#include "../libs/logging.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+
+
+
+
+/*======================== Macros & static functions ========================*/
+
+
+static bool is_dir (const char* path)
+{
+	struct stat info = {};
+	return stat(path, &info) == 0 && S_ISDIR(info.st_mode);
+}
+
+
+static bool has_ext (const char* path, const char* ext)
+{
+	size_t path_len = strlen(path);
+	size_t ext_len  = strlen(ext);
+
+	return path_len >= ext_len && strcmp(path + path_len - ext_len, ext) == 0;
+}
+
+
+static double seconds_since (const struct timespec* start)
+{
+	struct timespec now = {};
+	clock_gettime(CLOCK_MONOTONIC, &now);
+
+	return (double) (now.tv_sec - start->tv_sec)
+	     + (double) (now.tv_nsec - start->tv_nsec) / 1e9;
+}
+
+
+static bool write_ppm (FILE* output, const unsigned char* frame)
+{
+	if (fprintf(output, "P6\n%llu %llu\n255\n", VIDEO_WIDTH, VIDEO_HEIGHT) < 0)
+		return false;
+
+	unsigned char row[VIDEO_WIDTH * 3];
+	for (addr_t y = 0; y < VIDEO_HEIGHT; ++y)
+	{
+		for (addr_t x = 0; x < VIDEO_WIDTH; ++x)
+			memset(row + 3 * x, frame[y * VIDEO_WIDTH + x], 3);
+
+		if (fwrite(row, sizeof row, 1, output) != 1)
+			return false;
+	}
+
+	return true;
+}
+
+
+static bool write_numbered (capture_t* capture, const unsigned char* frame)
+{
+	char path[MAX_FRAME_PATH_SIZE];
+	int  len = snprintf(path, sizeof path, "%s/%06llu.ppm", capture->dir,
+	                    capture->frames);
+	if (len < 0 || (size_t) len >= sizeof path)
+		return false;
+
+	FILE* output = fopen(path, "wb");
+	if (!output)
+		return false;
+
+	bool written = write_ppm(output, frame);
+	return (fclose(output) == 0) && written;
+}
+
+
+
+
+/*========================= Functions implementation ========================*/
+
+
+capture_t* capture_open (const char* path, bool delta)
+{
+	if_log (is_bad_mem(path, 1), ERROR,
+		return NULL;)
+
+	capture_t* capture = (capture_t*) calloc(1, sizeof *capture);
+	if (!capture)
+		return NULL;
+
+	capture->delta   = delta;
+	capture->format  = has_ext(path, Y4M_EXT) ? CAPTURE_Y4M : CAPTURE_PPM;
+	capture->picture = (unsigned char*) calloc(VIDEO_MEM_SIZE, 1);
+	capture->frame   = (unsigned char*) calloc(VIDEO_MEM_SIZE, 1);
+
+	if (is_dir(path))
+	{
+		capture->dir    = path;
+		capture->format = CAPTURE_PPM;
+	}
+	else
+		capture->output = fopen(path, "wb");
+
+	if (!capture->picture || !capture->frame
+	    || (!capture->dir && !capture->output))
+	{
+		capture_close(capture, NULL);
+		return NULL;
+	}
+
+	if (capture->format == CAPTURE_Y4M
+	    && fprintf(capture->output, "YUV4MPEG2 W%llu H%llu F%s Ip A1:1 Cmono\n",
+	               VIDEO_WIDTH, VIDEO_HEIGHT, Y4M_FRAME_RATE) < 0)
+		capture->failed = true;
+
+	clock_gettime(CLOCK_MONOTONIC, &capture->start);
+	return capture;
+}
+
+
+bool capture_frame (capture_t* capture, const processor_value_t* video,
+                    const unsigned char* dirty_rows)
+{
+	if_log (is_bad_mem(capture, sizeof *capture), ERROR,
+		return false;)
+
+	if_log (is_bad_mem(video, VIDEO_MEM_SIZE * sizeof *video), ERROR,
+		return false;)
+
+	if_log (is_bad_mem(dirty_rows, VIDEO_HEIGHT), ERROR,
+		return false;)
+
+	if (capture->failed)
+		return false;
+
+	/* previous picture is zeroed before the first frame, so XOR with it
+	 * leaves the first frame unchanged                                  */
+	for (addr_t y = 0; y < VIDEO_HEIGHT; ++y)
+	{
+		unsigned char* picture = capture->picture + y * VIDEO_WIDTH;
+		unsigned char* delta   = capture->frame   + y * VIDEO_WIDTH;
+
+		if (capture->frame_rows[y])
+		{
+			memset(delta, 0, VIDEO_WIDTH);
+			capture->frame_rows[y] = 0;
+		}
+
+		if (!dirty_rows[y])
+			continue;
+
+		const processor_value_t* cells = video + y * VIDEO_WIDTH;
+		for (addr_t x = 0; x < VIDEO_WIDTH; ++x)
+		{
+			unsigned char luma = cells[x] ? 255 : 0;
+			delta[x]   = luma ^ picture[x];
+			picture[x] = luma;
+		}
+
+		capture->frame_rows[y] = 1;
+	}
+
+	const unsigned char* frame = capture->delta ? capture->frame
+	                                            : capture->picture;
+
+	bool written = false;
+	if (capture->dir)
+		written = write_numbered(capture, frame);
+	else if (capture->format == CAPTURE_Y4M)
+		written = fputs("FRAME\n", capture->output) >= 0
+		          && fwrite(frame, VIDEO_MEM_SIZE, 1, capture->output) == 1;
+	else
+		written = write_ppm(capture->output, frame);
+
+	if (!written)
+	{
+		capture->failed = true;
+		return false;
+	}
+
+	++capture->frames;
+	return true;
+}
+
+
+bool capture_close (capture_t* capture, FILE* report)
+{
+	if_log (is_bad_mem(capture, sizeof *capture), ERROR,
+		return false;)
+
+	if (report)
+	{
+		double seconds = seconds_since(&capture->start);
+		fprintf(report, "Captured frames: %llu, %.1f frames/sec\n",
+		        capture->frames,
+		        (seconds > 0) ? (double) capture->frames / seconds : 0.0);
+	}
+
+	bool success = !capture->failed;
+	if (capture->output && fclose(capture->output) != 0)
+		success = false;
+
+	free(capture->picture);
+	free(capture->frame);
+	free(capture);
+	return success;
+}
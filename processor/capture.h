@@ -0,0 +1,130 @@
+/*!
+ * @file
+ * @brief Header for capturing frames of video memory without display.
+ */
+
+#ifndef CAPTURE_H_
+#define CAPTURE_H_
+
+
+
+
+/*============================ Including headers ============================*/
+
+
+#include "../commands.h"
+
+#include <stdio.h>
+#include <stdbool.h>
+#include <time.h>
+
+
+
+
+/*=========================== Constants declaration =========================*/
+
+/*!
+ * Extension of capture path which selects YUV4MPEG2 stream.
+ */
+#define Y4M_EXT ".y4m"
+
+/*!
+ * Frame rate which is written in YUV4MPEG2 header.
+ */
+#define Y4M_FRAME_RATE "25:1"
+
+/*!
+ * Max length of path of numbered frame.
+ */
+#define MAX_FRAME_PATH_SIZE (size_t) 4096
+
+
+
+
+/*============================ Types declaration ============================*/
+
+/*!
+ * Format of captured frames.
+ */
+typedef enum capture_format_t_
+{
+	CAPTURE_PPM = 0, /*!< binary PPM (P6) frames.                            */
+	CAPTURE_Y4M = 1, /*!< YUV4MPEG2 stream with monochrome frames.           */
+}
+capture_format_t;
+
+/*!
+ * State of capture.
+ *
+ * Frames are written in one stream or, if capture path is directory,
+ * in numbered PPM files 000000.ppm, 000001.ppm, ... inside it.
+ */
+typedef struct capture_t_
+{
+	FILE*              output;   /*!< stream with frames or NULL
+	                                  if frames are numbered files.          */
+	const char*        dir;      /*!< directory with numbered frames.        */
+	capture_format_t   format;   /*!< format of frames.                      */
+	bool               delta;    /*!< frames are XOR of current and
+	                                  previous pictures.                     */
+	unsigned char*     picture;  /*!< luma of the last picture.              */
+	unsigned char*     frame;    /*!< difference between the last two
+	                                  pictures.                              */
+	unsigned char      frame_rows[VIDEO_HEIGHT]; /*!< rows of frame
+	                                  which may be non-zero.                 */
+	unsigned long long frames;   /*!< amount of written frames.              */
+	struct timespec    start;    /*!< time of capture_open().                */
+	bool               failed;   /*!< frame can't be written.                */
+}
+capture_t;
+
+
+
+
+/*========================== Functions declaration ==========================*/
+
+/*!
+ * Open capture. Format is YUV4MPEG2 if path ends with Y4M_EXT,
+ * else PPM.
+ *
+ * @return capture which must be closed by capture_close()
+ *         or NULL if output can't be opened.
+ */
+capture_t* capture_open
+(
+	const char* path, /*!< [in] file or directory for frames.                */
+	bool        delta /*!< [in] write differences between pictures.         */
+);
+
+/*!
+ * Write picture from video memory as the next frame.
+ *
+ * With delta encoding the first frame is the picture itself and every
+ * next one is XOR of its picture with the previous picture.
+ * Only rows which are marked in dirty_rows are converted.
+ *
+ * @return success of this operation.
+ */
+bool capture_frame
+(
+	capture_t*               capture,   /*!< [in,out] capture.               */
+	const processor_value_t* video,     /*!< [in]     video memory.          */
+	const unsigned char*     dirty_rows /*!< [in]     rows written after
+	                                                  the previous frame.    */
+);
+
+/*!
+ * Print amount of frames and frame rate, then close capture.
+ *
+ * @return false if some frame or the rest of stream can't be written.
+ */
+bool capture_close
+(
+	capture_t* capture, /*!< [in] capture.                                   */
+	FILE*      report   /*!< [in] stream for statistics.                     */
+);
+
+
+
+
+#endif // ifndef CAPTURE_H_
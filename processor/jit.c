@@ -0,0 +1,717 @@
+/*!
+ * @file
+ * @brief x86-64 template JIT compiler of decoded programs.
+ *
+ * Every decoded command is replaced by fixed sequence of machine
+ * instructions. Machine registers are used in the following way:
+ *
+ *  ebx      - top of operand stack;
+ *  r13      - operand stack pointer (values below the top);
+ *  r14      - call stack pointer (native return addresses);
+ *  r12      - processor's memory;
+ *  r15      - jit_context_t;
+ *  r8d-r11d - registers ax, bx, cx, dx;
+ *  ebp      - register ex.
+ *
+ * Other registers live in jit_context_t. Commands in, out, drw and sqrt
+ * and division by zero call C helpers.
+ */
+
+#define _DEFAULT_SOURCE
+
+
+
+/*============================ Including headers ============================*/
+
+
+#include "jit.h"
+#include "../libs/others.h"
+#include "../libs/logging.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <math.h>
+#include <sys/mman.h>
+
+
+
+
+/*======================== Macros & static functions ========================*/
+
+
+#if defined __x86_64__ && !defined DEBUGGER
+
+_Static_assert(sizeof (void*) == sizeof (addr_t),
+               "native return addresses are kept in processor's call stack");
+
+#define CTX_(FIELD_) (int32_t) offsetof(jit_context_t, FIELD_)
+
+enum machine_reg_t_
+{
+	RAX = 0, RCX = 1, RDX = 2,  RBX = 3,  RSP = 4,  RBP = 5,  RSI = 6,  RDI = 7,
+	R8  = 8, R9  = 9, R10 = 10, R11 = 11, R12 = 12, R13 = 13, R14 = 14, R15 = 15
+};
+
+enum condition_t_
+{
+	CC_B  = 0x2, CC_AE = 0x3, CC_E = 0x4, CC_NE = 0x5, CC_BE = 0x6,
+	CC_L  = 0xC, CC_GE = 0xD, CC_LE = 0xE, CC_G = 0xF
+};
+
+/*
+ * Machine registers which keep processor's registers
+ * (-1 means that register lives in jit_context_t).
+ */
+static const int MACHINE_REGS_[REGS_NUMBER] =
+{
+	R8, R9, R10, R11, RBP, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1
+};
+
+/*
+ * Registers which are saved around calls of helpers.
+ */
+static const int SAVED_REGS_[] = { R8, R9, R10, R11 };
+
+
+static void emit_byte (jit_t* jit, unsigned char byte)
+{
+	if (jit->size == jit->capacity)
+	{
+		size_t new_capacity = jit->capacity ? jit->capacity * 2 : 4096;
+		unsigned char* new_buff = (unsigned char*) realloc(jit->buff,
+		                                                   new_capacity);
+		if (!new_buff)
+		{
+			jit->failed = true;
+			return;
+		}
+		jit->buff     = new_buff;
+		jit->capacity = new_capacity;
+	}
+
+	jit->buff[jit->size++] = byte;
+}
+
+
+static void emit_u32 (jit_t* jit, uint32_t val)
+{
+	for (int i = 0; i < 4; ++i)
+		emit_byte(jit, (unsigned char) (val >> (8 * i)));
+}
+
+
+static void emit_u64 (jit_t* jit, uint64_t val)
+{
+	for (int i = 0; i < 8; ++i)
+		emit_byte(jit, (unsigned char) (val >> (8 * i)));
+}
+
+
+static void emit_rex (jit_t* jit, bool wide, int reg, int index, int base)
+{
+	unsigned char rex = 0x40 | (wide ? 0x8 : 0) | ((reg   & 8) ? 0x4 : 0)
+	                         | ((index & 8) ? 0x2 : 0) | ((base  & 8) ? 0x1 : 0);
+	if (rex != 0x40)
+		emit_byte(jit, rex);
+}
+
+
+static void emit_opcode (jit_t* jit, unsigned opcode)
+{
+	if (opcode > 0xFF)
+		emit_byte(jit, (unsigned char) (opcode >> 8));
+	emit_byte(jit, (unsigned char) opcode);
+}
+
+
+/* op reg, rm (register-direct)                                              */
+static void emit_rr (jit_t* jit, bool wide, unsigned opcode, int reg, int rm)
+{
+	emit_rex(jit, wide, reg, 0, rm);
+	emit_opcode(jit, opcode);
+	emit_byte(jit, 0xC0 | ((reg & 7) << 3) | (rm & 7));
+}
+
+
+/* op reg, [base + disp32]                                                   */
+static void emit_rm (jit_t* jit, bool wide, unsigned opcode,
+                     int reg, int base, int32_t disp)
+{
+	emit_rex(jit, wide, reg, 0, base);
+	emit_opcode(jit, opcode);
+	emit_byte(jit, 0x80 | ((reg & 7) << 3) | (base & 7));
+	if ((base & 7) == RSP)
+		emit_byte(jit, 0x24);
+	emit_u32(jit, (uint32_t) disp);
+}
+
+
+/* op reg, [base + index * 4]                                                */
+static void emit_rm_index (jit_t* jit, unsigned opcode,
+                           int reg, int base, int index)
+{
+	emit_rex(jit, false, reg, index, base);
+	emit_opcode(jit, opcode);
+	emit_byte(jit, 0x04 | ((reg & 7) << 3));
+	emit_byte(jit, 0x80 | ((index & 7) << 3) | (base & 7));
+}
+
+
+static void emit_mov_imm32 (jit_t* jit, int reg, uint32_t imm)
+{
+	emit_rex(jit, false, 0, 0, reg);
+	emit_byte(jit, 0xB8 | (reg & 7));
+	emit_u32(jit, imm);
+}
+
+
+static void emit_push (jit_t* jit, int reg)
+{
+	emit_rex(jit, false, 0, 0, reg);
+	emit_byte(jit, 0x50 | (reg & 7));
+}
+
+
+static void emit_pop (jit_t* jit, int reg)
+{
+	emit_rex(jit, false, 0, 0, reg);
+	emit_byte(jit, 0x58 | (reg & 7));
+}
+
+
+static void add_fixup (jit_t* jit, size_t label)
+{
+	if (jit->fixups_amount == jit->fixups_capacity)
+	{
+		size_t new_capacity = jit->fixups_capacity
+		                    ? jit->fixups_capacity * 2 : 256;
+		jit_fixup_t* new_ptr = (jit_fixup_t*) realloc(jit->fixups,
+		                       new_capacity * sizeof *jit->fixups);
+		if (!new_ptr)
+		{
+			jit->failed = true;
+			return;
+		}
+		jit->fixups          = new_ptr;
+		jit->fixups_capacity = new_capacity;
+	}
+
+	jit->fixups[jit->fixups_amount].pos   = jit->size;
+	jit->fixups[jit->fixups_amount].label = label;
+	++jit->fixups_amount;
+	emit_u32(jit, 0);
+}
+
+
+static void emit_jmp (jit_t* jit, size_t label)
+{
+	emit_byte(jit, 0xE9);
+	add_fixup(jit, label);
+}
+
+
+static void emit_jcc (jit_t* jit, int cond, size_t label)
+{
+	emit_byte(jit, 0x0F);
+	emit_byte(jit, 0x80 | cond);
+	add_fixup(jit, label);
+}
+
+
+static void emit_load_reg (jit_t* jit, int dst, reg_t reg)
+{
+	if (MACHINE_REGS_[reg] >= 0)
+		emit_rr(jit, false, 0x89, MACHINE_REGS_[reg], dst);
+	else
+		emit_rm(jit, false, 0x8B, dst, R15, CTX_(regs) + 4 * reg);
+}
+
+
+static void emit_store_reg (jit_t* jit, reg_t reg, int src)
+{
+	if (MACHINE_REGS_[reg] >= 0)
+		emit_rr(jit, false, 0x89, src, MACHINE_REGS_[reg]);
+	else
+		emit_rm(jit, false, 0x89, src, R15, CTX_(regs) + 4 * reg);
+}
+
+
+static void emit_call_helper (jit_t* jit, const void* helper)
+{
+	for (size_t i = 0; i < sizeof SAVED_REGS_ / sizeof *SAVED_REGS_; ++i)
+		emit_push(jit, SAVED_REGS_[i]);
+
+	emit_byte(jit, 0x48);                         // mov rax, helper
+	emit_byte(jit, 0xB8);
+	emit_u64(jit, (uint64_t) (uintptr_t) helper);
+	emit_rr(jit, false, 0xFF, 2, RAX);            // call rax
+
+	for (size_t i = sizeof SAVED_REGS_ / sizeof *SAVED_REGS_; i > 0; --i)
+		emit_pop(jit, SAVED_REGS_[i - 1]);
+}
+
+
+/*
+ * Mark row of video memory which is written by pop or in. Index
+ * of the written cell is in register index and it is destroyed.
+ */
+static void emit_mark_written (jit_t* jit, const instr_t* instr, int index)
+{
+	_Static_assert(VIDEO_WIDTH == 1 << 8, "row is index >> 8");
+
+	if (!(instr->mode & REG_ARG))
+	{
+		if ((uint32_t) instr->imm >= VIDEO_MEM_SIZE)
+			return;
+
+		emit_rm(jit, true, 0x8B, RDX, R15, CTX_(dirty_rows));
+		emit_rm(jit, false, 0xC6, 0, RDX,                   // mov [rdx + row], 1
+		        (int32_t) ((uint32_t) instr->imm / VIDEO_WIDTH));
+		emit_byte(jit, 1);
+		return;
+	}
+
+	emit_rr(jit, false, 0x81, 7, index);            // cmp index, VIDEO_MEM_SIZE
+	emit_u32(jit, (uint32_t) VIDEO_MEM_SIZE);
+	emit_byte(jit, 0x73);                           // jae done
+	emit_byte(jit, 0);
+	size_t jae_pos = jit->size;
+
+	emit_rr(jit, false, 0xC1, 5, index);            // shr index, 8
+	emit_byte(jit, 8);
+	emit_rm(jit, true, 0x8B, RDX, R15, CTX_(dirty_rows));
+	emit_rr(jit, true, 0x01, index, RDX);           // add rdx, index
+	emit_rm(jit, false, 0xC6, 0, RDX, 0);           // mov [rdx], 1
+	emit_byte(jit, 1);
+
+	if (!jit->failed)
+		jit->buff[jae_pos - 1] = (unsigned char) (jit->size - jae_pos);
+}
+
+
+/* rax = index of memory cell which is addressed by memory argument          */
+/*
+ * Memory index is 32-bit unsigned like in load_mem_arg(): 32-bit
+ * operations clear the upper half of the register.
+ */
+static void emit_mem_index (jit_t* jit, const instr_t* instr, int dst)
+{
+	if (instr->mode & REG_ARG)
+	{
+		emit_load_reg(jit, dst, instr->reg);
+		emit_rr(jit, false, 0x81, 0, dst);        // add dst, imm
+		emit_u32(jit, (uint32_t) instr->imm);
+	}
+	else
+		emit_mov_imm32(jit, dst, (uint32_t) instr->imm);
+}
+
+
+#define OVERFLOW_LABEL_(JIT_)  ((JIT_)->exit_label + 1)
+
+#define UNDERFLOW_LABEL_(JIT_) ((JIT_)->exit_label + 2)
+
+static void emit_underflow_check (jit_t* jit, int32_t min_field)
+{
+	emit_rm(jit, true, 0x3B, R13, R15, min_field);  // cmp r13, [r15 + min]
+	emit_jcc(jit, CC_B, UNDERFLOW_LABEL_(jit));
+}
+
+
+/* old top is moved into operand stack, ebx has to be assigned new top       */
+static void emit_push_ebx (jit_t* jit)
+{
+	emit_rm(jit, true, 0x3B, R13, R15, CTX_(stack_limit));
+	emit_jcc(jit, CC_AE, OVERFLOW_LABEL_(jit));
+	emit_rm(jit, false, 0x89, RBX, R13, 0);         // mov [r13], ebx
+	emit_rr(jit, true, 0x83, 0, R13);               // add r13, 4
+	emit_byte(jit, 4);
+}
+
+
+/* removes the top, new top is loaded into ebx                               */
+static void emit_drop (jit_t* jit, int32_t count)
+{
+	emit_rm(jit, false, 0x8B, RBX, R13, -4 * count); // mov ebx, [r13 - 4n]
+	emit_rr(jit, true, 0x83, 5, R13);                // sub r13, 4n
+	emit_byte(jit, (unsigned char) (4 * count));
+}
+
+
+static processor_value_t jit_helper_in (processor_value_t old,
+                                         jit_context_t*    ctx)
+{
+	processor_value_t val = old;
+	proc_io_read(&ctx->proc->io, &val);
+	return val;
+}
+
+
+static void jit_helper_out (processor_value_t val, jit_context_t* ctx)
+{
+	proc_io_write(&ctx->proc->io, val);
+}
+
+
+static processor_value_t jit_helper_sqrt (processor_value_t val)
+{
+	return (processor_value_t) sqrt(val);
+}
+
+
+static void jit_helper_div_by_zero (jit_context_t* ctx)
+{
+	proc_io_puts(&ctx->proc->io, "Dividing by zero.");
+}
+
+
+static void jit_helper_drw (jit_context_t* ctx)
+{
+	redraw(ctx->proc);
+}
+
+
+static void emit_prologue (jit_t* jit)
+{
+	static const int SAVED[] = { RBX, RBP, R12, R13, R14, R15 };
+	for (size_t i = 0; i < sizeof SAVED / sizeof *SAVED; ++i)
+		emit_push(jit, SAVED[i]);
+
+	emit_rr(jit, true, 0x83, 5, RSP);               // sub rsp, 8
+	emit_byte(jit, 8);
+
+	emit_rr(jit, true, 0x89, RDI, R15);             // mov r15, rdi
+	emit_rm(jit, true, 0x8B, R12, R15, CTX_(mem));
+	emit_rm(jit, true, 0x8B, R13, R15, CTX_(stack_base));
+	emit_rm(jit, true, 0x8B, R14, R15, CTX_(call_base));
+	emit_rr(jit, false, 0x31, RBX, RBX);            // xor ebx, ebx
+
+	for (reg_t reg = 0; reg < REGS_NUMBER; ++reg)
+		if (MACHINE_REGS_[reg] >= 0)
+			emit_rm(jit, false, 0x8B, MACHINE_REGS_[reg], R15,
+			        CTX_(regs) + 4 * reg);
+}
+
+
+static void emit_epilogue (jit_t* jit, proc_error_t err)
+{
+	for (reg_t reg = 0; reg < REGS_NUMBER; ++reg)
+		if (MACHINE_REGS_[reg] >= 0)
+			emit_rm(jit, false, 0x89, MACHINE_REGS_[reg], R15,
+			        CTX_(regs) + 4 * reg);
+
+	emit_mov_imm32(jit, RAX, (uint32_t) err);
+
+	emit_rr(jit, true, 0x83, 0, RSP);               // add rsp, 8
+	emit_byte(jit, 8);
+
+	static const int SAVED[] = { R15, R14, R13, R12, RBP, RBX };
+	for (size_t i = 0; i < sizeof SAVED / sizeof *SAVED; ++i)
+		emit_pop(jit, SAVED[i]);
+
+	emit_byte(jit, 0xC3);                           // ret
+}
+
+#endif // defined __x86_64__ && !defined DEBUGGER
+
+
+
+
+/*========================= Functions implementation ========================*/
+
+
+#if defined __x86_64__ && !defined DEBUGGER
+
+proc_error_t jit_run (proc_state_t proc)
+{
+	if_log (is_bad_mem(proc, sizeof *proc), ERROR,
+		return ALLOC_ERR;)
+
+	size_t code_size = 0;
+	void*  code      = jit_compile(proc, &code_size);
+	if (!code)
+		return ALLOC_ERR;
+
+	/* sandbox may leave native code by longjmp, so proc_delete()
+	 * unmaps it in that case                                     */
+	proc->native      = code;
+	proc->native_size = code_size;
+
+	jit_context_t ctx = {};
+	memcpy(ctx.regs, proc->regs, sizeof ctx.regs);
+	ctx.mem         = proc->mem;
+	ctx.stack_base  = proc->stack.data;
+	ctx.stack_min1  = ctx.stack_base + 1;
+	ctx.stack_min2  = ctx.stack_base + 2;
+	ctx.stack_limit = ctx.stack_base + proc->stack.capacity;
+	ctx.call_base   = (void**) proc->address_stack.data;
+	ctx.call_limit  = ctx.call_base + proc->address_stack.capacity;
+	ctx.proc        = proc;
+	ctx.dirty_rows  = proc->dirty_rows;
+
+	int (*native)(jit_context_t*) = (int (*)(jit_context_t*)) code;
+	proc_error_t err = (proc_error_t) native(&ctx);
+
+	memcpy(proc->regs, ctx.regs, sizeof ctx.regs);
+	munmap(code, code_size);
+	proc->native = NULL;
+
+	return err;
+}
+
+
+void* jit_compile (proc_state_t proc, size_t* size)
+{
+	if_log (is_bad_mem(proc, sizeof *proc), ERROR,
+		return NULL;)
+
+	if_log (is_bad_mem(size, sizeof *size), ERROR,
+		return NULL;)
+
+	jit_t jit = {};
+	jit.exit_label = proc->code_size;
+	jit.labels     = (size_t*) calloc(proc->code_size + 3, sizeof *jit.labels);
+	if (!jit.labels)
+		return NULL;
+
+	emit_prologue(&jit);
+
+	for (size_t i = 0; i < proc->code_size; ++i)
+	{
+		jit.labels[i] = jit.size;
+		jit_instruction(&jit, proc->code + i, i);
+	}
+
+	jit.labels[jit.exit_label] = jit.size;
+	emit_epilogue(&jit, NO_PROC_ERR);
+
+	jit.labels[OVERFLOW_LABEL_(&jit)] = jit.size;
+	emit_epilogue(&jit, STACK_OVERFLOW);
+
+	jit.labels[UNDERFLOW_LABEL_(&jit)] = jit.size;
+	emit_epilogue(&jit, STACK_UNDERFLOW);
+
+	void* code = NULL;
+	if (!jit.failed)
+	{
+		for (size_t i = 0; i < jit.fixups_amount; ++i)
+		{
+			size_t  pos = jit.fixups[i].pos;
+			int32_t rel = (int32_t) (jit.labels[jit.fixups[i].label]
+			                         - (pos + 4));
+			memcpy(jit.buff + pos, &rel, sizeof rel);
+		}
+
+		code = mmap(NULL, jit.size, PROT_READ | PROT_WRITE,
+		            MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+		if (code == MAP_FAILED)
+			code = NULL;
+		else
+		{
+			memcpy(code, jit.buff, jit.size);
+
+			/* policy may forbid executable mappings (W^X, SELinux)     */
+			if (mprotect(code, jit.size, PROT_READ | PROT_EXEC) != 0)
+			{
+				munmap(code, jit.size);
+				code = NULL;
+			}
+			else
+				*size = jit.size;
+		}
+	}
+
+	free(jit.buff);
+	free(jit.labels);
+	free(jit.fixups);
+	return code;
+}
+
+
+void jit_instruction (jit_t* jit, const instr_t* instr, size_t index)
+{
+	if_log (is_bad_mem(jit, sizeof *jit), ERROR,
+		return;)
+
+	if_log (is_bad_mem(instr, sizeof *instr), ERROR,
+		return;)
+
+	static const int CONDITIONS[] =
+	{
+		[cmd_je] = CC_E, [cmd_jne] = CC_NE, [cmd_jb] = CC_L,
+		[cmd_jnb] = CC_GE, [cmd_ja] = CC_G, [cmd_jna] = CC_LE,
+	};
+
+	switch (instr->cmd)
+	{
+		case cmd_hit:
+			emit_jmp(jit, jit->exit_label);
+			break;
+
+		case cmd_noc:
+			break;
+
+		case cmd_jmp:
+			emit_jmp(jit, instr->target);
+			break;
+
+		case cmd_je: case cmd_jne: case cmd_jb:
+		case cmd_jnb: case cmd_ja: case cmd_jna:
+			emit_underflow_check(jit, CTX_(stack_min2));
+			emit_rr(jit, false, 0x89, RBX, RCX);           // mov ecx, ebx
+			emit_rm(jit, false, 0x8B, RAX, R13, -4);       // mov eax, [r13-4]
+			emit_drop(jit, 2);
+			emit_rr(jit, false, 0x39, RAX, RCX);           // cmp ecx, eax
+			emit_jcc(jit, CONDITIONS[instr->cmd], instr->target);
+			break;
+
+		case cmd_call:
+			emit_rm(jit, true, 0x3B, R14, R15, CTX_(call_limit));
+			emit_jcc(jit, CC_AE, OVERFLOW_LABEL_(jit));
+			emit_byte(jit, 0x48);                          // lea rax, [next]
+			emit_byte(jit, 0x8D);
+			emit_byte(jit, 0x05);
+			add_fixup(jit, index + 1);
+			emit_rm(jit, true, 0x89, RAX, R14, 0);         // mov [r14], rax
+			emit_rr(jit, true, 0x83, 0, R14);              // add r14, 8
+			emit_byte(jit, 8);
+			emit_jmp(jit, instr->target);
+			break;
+
+		case cmd_ret:
+			emit_rm(jit, true, 0x3B, R14, R15, CTX_(call_base));
+			emit_jcc(jit, CC_BE, jit->exit_label);
+			emit_rr(jit, true, 0x83, 5, R14);              // sub r14, 8
+			emit_byte(jit, 8);
+			emit_rm(jit, false, 0xFF, 4, R14, 0);          // jmp [r14]
+			break;
+
+		case cmd_push:
+			emit_push_ebx(jit);
+			if (instr->mode & ADDR_ARG)
+			{
+				emit_mem_index(jit, instr, RAX);
+				emit_rm_index(jit, 0x8B, RBX, R12, RAX);   // ebx = mem[rax]
+			}
+			else if (instr->mode & REG_ARG)
+				emit_load_reg(jit, RBX, instr->reg);
+			else
+				emit_mov_imm32(jit, RBX, (uint32_t) instr->imm);
+			break;
+
+		case cmd_pop:
+			emit_underflow_check(jit, CTX_(stack_min1));
+			if (instr->mode & ADDR_ARG)
+			{
+				emit_mem_index(jit, instr, RAX);
+				emit_rm_index(jit, 0x89, RBX, R12, RAX);   // mem[rax] = ebx
+				emit_mark_written(jit, instr, RAX);
+			}
+			else if (instr->mode & REG_ARG)
+				emit_store_reg(jit, instr->reg, RBX);
+			emit_drop(jit, 1);
+			break;
+
+		case cmd_add:
+		case cmd_sub:
+		case cmd_mul:
+			emit_underflow_check(jit, CTX_(stack_min2));
+			emit_rm(jit, false, (instr->cmd == cmd_add) ? 0x03    // add
+			                  : (instr->cmd == cmd_sub) ? 0x2B    // sub
+			                                            : 0x0FAF, // imul
+			        RBX, R13, -4);
+			emit_rr(jit, true, 0x83, 5, R13);              // sub r13, 4
+			emit_byte(jit, 4);
+			break;
+
+		case cmd_div:
+			emit_underflow_check(jit, CTX_(stack_min2));
+			emit_rm(jit, false, 0x8B, RCX, R13, -4);       // ecx = second
+			emit_rr(jit, false, 0x85, RCX, RCX);           // test ecx, ecx
+			emit_byte(jit, 0x75);                          // jnz divide
+			emit_byte(jit, 0);
+			{
+				size_t jnz_pos = jit->size;
+				emit_drop(jit, 2);
+				emit_rr(jit, true, 0x89, R15, RDI);        // rdi = r15
+				emit_call_helper(jit, (const void*) jit_helper_div_by_zero);
+				emit_byte(jit, 0xEB);                      // jmp done
+				emit_byte(jit, 0);
+				size_t jmp_pos = jit->size;
+
+				if (!jit->failed)
+					jit->buff[jnz_pos - 1] = (unsigned char) (jit->size
+					                                          - jnz_pos);
+				emit_rr(jit, false, 0x89, RBX, RAX);       // eax = top
+				emit_byte(jit, 0x99);                      // cdq
+				emit_rr(jit, false, 0xF7, 7, RCX);         // idiv ecx
+				emit_rr(jit, false, 0x89, RAX, RBX);       // ebx = eax
+				emit_rr(jit, true, 0x83, 5, R13);          // sub r13, 4
+				emit_byte(jit, 4);
+
+				if (!jit->failed)
+					jit->buff[jmp_pos - 1] = (unsigned char) (jit->size
+					                                          - jmp_pos);
+			}
+			break;
+
+		case cmd_sqrt:
+			emit_underflow_check(jit, CTX_(stack_min1));
+			emit_rr(jit, false, 0x89, RBX, RDI);           // edi = ebx
+			emit_call_helper(jit, (const void*) jit_helper_sqrt);
+			emit_rr(jit, false, 0x89, RAX, RBX);           // ebx = eax
+			break;
+
+		case cmd_in:
+			if (instr->mode & ADDR_ARG)
+			{
+				emit_mem_index(jit, instr, RAX);
+				emit_rm_index(jit, 0x8B, RDI, R12, RAX);   // edi = mem[rax]
+			}
+			else if (instr->mode & REG_ARG)
+				emit_load_reg(jit, RDI, instr->reg);
+			else
+				emit_mov_imm32(jit, RDI, (uint32_t) instr->imm);
+
+			emit_rr(jit, true, 0x89, R15, RSI);            // rsi = r15
+			emit_call_helper(jit, (const void*) jit_helper_in);
+
+			if (instr->mode & ADDR_ARG)
+			{
+				emit_mem_index(jit, instr, RCX);
+				emit_rm_index(jit, 0x89, RAX, R12, RCX);   // mem[rcx] = eax
+				emit_mark_written(jit, instr, RCX);
+			}
+			else if (instr->mode & REG_ARG)
+				emit_store_reg(jit, instr->reg, RAX);
+			break;
+
+		case cmd_out:
+			emit_underflow_check(jit, CTX_(stack_min1));
+			emit_rr(jit, false, 0x89, RBX, RDI);           // edi = ebx
+			emit_rr(jit, true, 0x89, R15, RSI);            // rsi = r15
+			emit_call_helper(jit, (const void*) jit_helper_out);
+			break;
+
+		case cmd_drw:
+			emit_rr(jit, true, 0x89, R15, RDI);            // rdi = r15
+			emit_call_helper(jit, (const void*) jit_helper_drw);
+			break;
+
+		default:
+			emit_jmp(jit, jit->exit_label);
+			break;
+	}
+}
+
+#else // defined __x86_64__ && !defined DEBUGGER
+
+proc_error_t jit_run (proc_state_t proc)
+{
+	(void) proc;
+	return ALLOC_ERR;
+}
+
+#endif // defined __x86_64__ && !defined DEBUGGER
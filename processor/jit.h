@@ -0,0 +1,126 @@
+/*!
+ * @file
+ * @brief Header for x86-64 template JIT compiler of decoded programs.
+ */
+
+#ifndef JIT_H_
+#define JIT_H_
+
+
+
+
+/*============================ Including headers ============================*/
+
+
+#include "processor.h"
+
+#include <stddef.h>
+#include <stdbool.h>
+
+
+
+
+/*============================ Types declaration ============================*/
+
+/*!
+ * Data which native code uses during the execution.
+ *
+ * Pointer to this structure is kept in r15 while native code runs.
+ */
+typedef struct jit_context_t_
+{
+	processor_value_t  regs[REGS_NUMBER]; /*!< registers which aren't kept
+	                                           in machine registers.         */
+	processor_value_t* mem;               /*!< processor's memory.           */
+	processor_value_t* stack_base;        /*!< bottom of operand stack.      */
+	processor_value_t* stack_min1;        /*!< stack pointer when operand
+	                                           stack has one value.          */
+	processor_value_t* stack_min2;        /*!< stack pointer when operand
+	                                           stack has two values.         */
+	processor_value_t* stack_limit;       /*!< end of operand stack.         */
+	void**             call_base;         /*!< bottom of call stack.         */
+	void**             call_limit;        /*!< end of call stack.            */
+	proc_state_t       proc;              /*!< processor state.              */
+	unsigned char*     dirty_rows;        /*!< rows of video memory which
+	                                           are written after drw.        */
+}
+jit_context_t;
+
+/*!
+ * Place in native code where the distance to label has to be written.
+ */
+typedef struct jit_fixup_t_
+{
+	size_t pos;   /*!< position of rel32 field in native code.               */
+	size_t label; /*!< label index.                                          */
+}
+jit_fixup_t;
+
+/*!
+ * State of JIT compilation.
+ *
+ * Labels 0 .. code_size - 1 are decoded instructions, label code_size
+ * is the normal exit and next two labels are stack overflow
+ * and stack underflow exits.
+ */
+typedef struct jit_t_
+{
+	unsigned char* buff;             /*!< emitted native code.               */
+	size_t         size;             /*!< size of emitted code.              */
+	size_t         capacity;         /*!< capacity of buffer with code.      */
+	size_t*        labels;           /*!< offsets of labels in native code.  */
+	size_t         exit_label;       /*!< index of normal exit's label.      */
+	jit_fixup_t*   fixups;           /*!< places where labels are used.      */
+	size_t         fixups_amount;    /*!< amount of fixups.                  */
+	size_t         fixups_capacity;  /*!< capacity of array with fixups.     */
+	bool           failed;           /*!< allocation error occured.          */
+}
+jit_t;
+
+
+
+
+/*========================== Functions declaration ==========================*/
+
+/*!
+ * Translate decoded program into native code and run it.
+ *
+ * @note superinstructions aren't supported, so program
+ *       mustn't be processed by fuse_instructions().
+ *
+ * @return error code that occured during the execution.
+ *         If native code can't be created it returns ALLOC_ERR
+ *         without running the program. The code isn't printed,
+ *         unlike errors of commands (e.g. drw) which set proc->error
+ *         and are printed at once.
+ */
+proc_error_t jit_run
+(
+	proc_state_t proc /*!< [in,out] processor state.                         */
+);
+
+/*!
+ * Translate decoded program into native code.
+ *
+ * @return executable memory with native code if success else NULL.
+ */
+void* jit_compile
+(
+	proc_state_t proc, /*!< [in]  processor state.                           */
+	size_t*      size  /*!< [out] size of executable memory.                 */
+);
+
+/*!
+ * Translate one decoded instruction.
+ */
+void jit_instruction
+(
+	jit_t*         jit,   /*!< [in,out] compilation state.                   */
+	const instr_t* instr, /*!< [in]     translated instruction.              */
+	size_t         index  /*!< [in]     index of instruction.                */
+);
+
+
+
+
+#endif // ifndef JIT_H_
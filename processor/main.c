@@ -7,32 +7,142 @@
 #include "processor.h"
 
 #include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <limits.h>
 #include <string.h>
 
 
+static bool parse_size (const char* str, size_t* size)
+{
+	char*              end = NULL;
+	unsigned long long val = strtoull(str, &end, 10);
+	if (end == str || *end != '\0' || val == 0 || val > SIZE_MAX / 8)
+		return false;
+
+	*size = (size_t) val;
+	return true;
+}
+
+
+static bool parse_option (proc_options_t* options, const char* option)
+{
+	if (strcmp(option, "--engine=switch") == 0)
+		options->engine = ENGINE_SWITCH;
+	else if (strcmp(option, "--engine=threaded") == 0)
+		options->engine = ENGINE_THREADED;
+	else if (strcmp(option, "--engine=cached") == 0)
+		options->engine = ENGINE_CACHED;
+	else if (strcmp(option, "--engine=jit") == 0
+	         || strcmp(option, "--jit") == 0)
+		options->engine = ENGINE_JIT;
+	else if (strcmp(option, "--no-fusion") == 0)
+		options->fusion = false;
+	else if (strcmp(option, "--headless") == 0)
+		options->headless = true;
+	else if (strcmp(option, "--count") == 0)
+		options->count = true;
+	else if (strcmp(option, "--huge-pages") == 0)
+		options->huge_pages = true;
+	else if (strcmp(option, "--sandbox") == 0)
+		options->sandbox = true;
+	else if (strcmp(option, "--stream") == 0)
+		options->stream = true;
+	else if (strcmp(option, "--binary-io") == 0)
+		options->binary_io = true;
+	else if (strncmp(option, "--capture=", 10) == 0 && option[10] != '\0')
+		options->capture = option + 10;
+	else if (strcmp(option, "--delta") == 0)
+		options->delta = true;
+	else if (strncmp(option, "--fps=", 6) == 0)
+	{
+		size_t fps = 0;
+		if (!parse_size(option + 6, &fps) || fps > UINT_MAX)
+			return false;
+
+		options->fps = (unsigned) fps;
+	}
+	else if (strncmp(option, "--stack-size=", 13) == 0)
+		return parse_size(option + 13, &options->stack_size);
+	else if (strncmp(option, "--call-stack-size=", 18) == 0)
+		return parse_size(option + 18, &options->call_stack_size);
+	else
+		return false;
+
+	return true;
+}
+
+
 int main (int argc, char* argv[])
 {
-	if (argc != 2)
+	proc_options_t options =
+	{
+		.engine          = ENGINE_CACHED,
+		.fusion          = true,
+		.stack_size      = DEFAULT_STACK_SIZE,
+		.call_stack_size = DEFAULT_CALL_STACK_SIZE,
+		.headless        = false,
+		.capture         = NULL,
+		.delta           = false,
+		.fps             = 0,
+		.count           = false,
+		.huge_pages      = false,
+		.sandbox         = false,
+		.stream          = false,
+		.binary_io       = false,
+	};
+
+	const char* fname = NULL;
+	for (int i = 1; i < argc; ++i)
+	{
+		if (strncmp(argv[i], "--", 2) != 0)
+		{
+			if (fname)
+			{
+				fputs("Wrong amount of arguments.\n", stderr);
+				return 1;
+			}
+			fname = argv[i];
+		}
+		else if (!parse_option(&options, argv[i]))
+		{
+			fprintf(stderr, "Unknown option: %s\n", argv[i]);
+			return 1;
+		}
+	}
+
+	if (options.count)
+	{
+		options.engine = ENGINE_SWITCH;
+		options.fusion = false;
+	}
+
+	if (!fname)
 	{
 		fputs("Wrong amount of arguments.\n", stderr);
 		return 1;
 	}
 
-	if (strcmp(get_ext(argv[1]), EXEC_EXT) != 0)
+	/* "-" is standard input, it is always streamed */
+	bool from_stdin = strcmp(fname, "-") == 0;
+
+	if (!from_stdin && strcmp(get_ext(fname), EXEC_EXT) != 0)
 	{
 		fputs("Wrong file extension.\n", stderr);
 		return 1;
 	}
 
-	FILE* input = fopen(argv[1], "rb");
+	FILE* input = from_stdin ? stdin : fopen(fname, "rb");
 	if (!input)
 	{
 		fputs("File cannot be opened.\n", stderr);
 		return 1;
 	}
 
-	int success = (run(input) == NO_PROC_ERR) ? 0 : 1;
+	int success = (run(input, &options) == NO_PROC_ERR) ? 0 : 1;
+
+	if (!from_stdin)
+		fclose(input);
 
-	fclose(input);
 	return success;
 }
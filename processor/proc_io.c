@@ -0,0 +1,270 @@
+/*!
+ * @file
+ * @brief Buffered input and output of commands in and out.
+ *
+ * Values are parsed and printed without stdio, and descriptors are
+ * accessed only when buffers are exhausted.
+ */
+
+#define _DEFAULT_SOURCE
+
+
+
+/*============================ Including headers ============================*/
+
+
+#include "proc_io.h"
+#include "../libs/others.h"
+#include "../libs/logging.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <errno.h>
+#include <unistd.h>
+
+
+
+
+/*======================== Macros & static functions ========================*/
+
+
+static void write_all (proc_io_t* io, const unsigned char* data, size_t size)
+{
+	while (size > 0 && !io->failed)
+	{
+		ssize_t written = write(io->out_fd, data, size);
+		if (written < 0 && errno == EINTR)
+			continue;
+
+		if (written <= 0)
+			io->failed = true;
+		else
+		{
+			data += written;
+			size -= (size_t) written;
+		}
+	}
+}
+
+
+static void append (proc_io_t* io, const void* data, size_t size)
+{
+	if (io->out_size + size > IO_BUFFER_SIZE)
+	{
+		proc_io_flush(io);
+
+		if (size > IO_BUFFER_SIZE)
+		{
+			write_all(io, (const unsigned char*) data, size);
+			return;
+		}
+	}
+
+	memcpy(io->out + io->out_size, data, size);
+	io->out_size += size;
+}
+
+
+/*
+ * Receive next part of input. Output is flushed first, because
+ * the reader of output may be the one who writes input.
+ */
+static bool refill (proc_io_t* io)
+{
+	if (io->in_eof)
+		return false;
+
+	proc_io_flush(io);
+
+	ssize_t received = 0;
+	do
+		received = read(io->in_fd, io->in, IO_BUFFER_SIZE);
+	while (received < 0 && errno == EINTR);
+
+	/* read error ends input like scanf() does                          */
+	if (received <= 0)
+	{
+		io->in_eof = true;
+		return false;
+	}
+
+	io->in_pos  = 0;
+	io->in_size = (size_t) received;
+	return true;
+}
+
+
+static inline int peek_byte (proc_io_t* io)
+{
+	if (io->in_pos == io->in_size && !refill(io))
+		return EOF;
+
+	return io->in[io->in_pos];
+}
+
+
+static inline bool is_space (int c)
+{
+	return c == ' ' || (c >= '\t' && c <= '\r');
+}
+
+
+static bool read_text (proc_io_t* io, processor_value_t* val)
+{
+	int c = 0;
+	while (is_space(c = peek_byte(io)))
+		++io->in_pos;
+
+	bool negative = false;
+	if (c == '-' || c == '+')
+	{
+		negative = (c == '-');
+		++io->in_pos;
+		c = peek_byte(io);
+	}
+
+	if (c < '0' || c > '9')
+		return false;
+
+	/* overflow wraps around like arithmetic commands do                */
+	uint32_t abs_val = 0;
+	do
+	{
+		abs_val = abs_val * 10 + (uint32_t) (c - '0');
+		++io->in_pos;
+	}
+	while ((c = peek_byte(io)) >= '0' && c <= '9');
+
+	*val = (processor_value_t) (negative ? 0u - abs_val : abs_val);
+	return true;
+}
+
+
+static bool read_binary (proc_io_t* io, processor_value_t* val)
+{
+	uint32_t frame = 0;
+	for (size_t i = 0; i < sizeof frame; ++i)
+	{
+		int c = peek_byte(io);
+		if (c == EOF)
+			return false;
+
+		frame |= (uint32_t) c << (8 * i);
+		++io->in_pos;
+	}
+
+	*val = (processor_value_t) frame;
+	return true;
+}
+
+
+
+
+/*========================= Functions implementation ========================*/
+
+
+bool proc_io_init (proc_io_t* io, int in_fd, int out_fd, bool binary)
+{
+	if_log (is_bad_mem(io, sizeof *io), ERROR,
+		return false;)
+
+	io->in_fd    = in_fd;
+	io->out_fd   = out_fd;
+	io->in       = (unsigned char*) malloc(IO_BUFFER_SIZE);
+	io->out      = (unsigned char*) malloc(IO_BUFFER_SIZE);
+	io->in_pos   = 0;
+	io->in_size  = 0;
+	io->in_eof   = false;
+	io->out_size = 0;
+	io->binary   = binary;
+	io->failed   = false;
+
+	return io->in && io->out;
+}
+
+
+void proc_io_delete (proc_io_t* io)
+{
+	if_log (is_bad_mem(io, sizeof *io), ERROR,
+		return;)
+
+	free(io->in);
+	free(io->out);
+	io->in  = NULL;
+	io->out = NULL;
+}
+
+
+bool proc_io_read (proc_io_t* io, processor_value_t* val)
+{
+	if_log (is_bad_mem(io, sizeof *io), ERROR,
+		return false;)
+
+	return io->binary ? read_binary(io, val) : read_text(io, val);
+}
+
+
+void proc_io_write (proc_io_t* io, processor_value_t val)
+{
+	if_log (is_bad_mem(io, sizeof *io), ERROR,
+		return;)
+
+	if (io->binary)
+	{
+		uint32_t      frame = (uint32_t) val;
+		unsigned char bytes[sizeof frame];
+		for (size_t i = 0; i < sizeof frame; ++i)
+			bytes[i] = (unsigned char) (frame >> (8 * i));
+
+		append(io, bytes, sizeof bytes);
+		return;
+	}
+
+	char     text[MAX_VALUE_TEXT_SIZE];
+	char*    begin   = text + MAX_VALUE_TEXT_SIZE;
+	uint32_t abs_val = (val < 0) ? 0u - (uint32_t) val : (uint32_t) val;
+
+	*--begin = '\n';
+	do
+	{
+		*--begin = (char) ('0' + abs_val % 10);
+		abs_val /= 10;
+	}
+	while (abs_val > 0);
+
+	if (val < 0)
+		*--begin = '-';
+
+	append(io, begin, (size_t) (text + MAX_VALUE_TEXT_SIZE - begin));
+}
+
+
+void proc_io_puts (proc_io_t* io, const char* str)
+{
+	if_log (is_bad_mem(io, sizeof *io), ERROR,
+		return;)
+
+	if (io->binary)
+	{
+		fputs(str, stderr);
+		fputc('\n', stderr);
+		return;
+	}
+
+	append(io, str, strlen(str));
+	append(io, "\n", 1);
+}
+
+
+bool proc_io_flush (proc_io_t* io)
+{
+	if_log (is_bad_mem(io, sizeof *io), ERROR,
+		return false;)
+
+	write_all(io, io->out, io->out_size);
+	io->out_size = 0;
+
+	return !io->failed;
+}
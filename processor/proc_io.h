@@ -0,0 +1,132 @@
+/*!
+ * @file
+ * @brief Header for buffered input and output of commands in and out.
+ */
+
+#ifndef PROC_IO_H_
+#define PROC_IO_H_
+
+
+
+
+/*============================ Including headers ============================*/
+
+
+#include "../commands.h"
+
+#include <stddef.h>
+#include <stdbool.h>
+
+
+
+
+/*=========================== Constants declaration =========================*/
+
+/*!
+ * Size of input buffer and output buffer.
+ */
+#define IO_BUFFER_SIZE (size_t) (1 << 16)
+
+/*!
+ * Max length of value printed in text mode: sign, 10 digits and '\n'.
+ */
+#define MAX_VALUE_TEXT_SIZE (size_t) 12
+
+
+
+
+/*============================ Types declaration ============================*/
+
+/*!
+ * Buffers of processor's input and output.
+ *
+ * In text mode values are decimal numbers separated by whitespaces
+ * and every printed value is followed by '\n'. In binary mode every
+ * value is 4-byte little-endian frame.
+ */
+typedef struct proc_io_t_
+{
+	int            in_fd;    /*!< input descriptor.                          */
+	int            out_fd;   /*!< output descriptor.                         */
+	unsigned char* in;       /*!< received bytes.                            */
+	size_t         in_pos;   /*!< position of the first unread byte.         */
+	size_t         in_size;  /*!< amount of received bytes.                  */
+	bool           in_eof;   /*!< input is over.                             */
+	unsigned char* out;      /*!< bytes which aren't written yet.            */
+	size_t         out_size; /*!< amount of such bytes.                      */
+	bool           binary;   /*!< binary mode.                               */
+	bool           failed;   /*!< output can't be written.                   */
+}
+proc_io_t;
+
+
+
+
+/*========================== Functions declaration ==========================*/
+
+/*!
+ * Allocate buffers.
+ *
+ * @return success of this operation.
+ */
+bool proc_io_init
+(
+	proc_io_t* io,     /*!< [out] buffers.                                   */
+	int        in_fd,  /*!< [in]  input descriptor.                          */
+	int        out_fd, /*!< [in]  output descriptor.                         */
+	bool       binary  /*!< [in]  binary mode.                               */
+);
+
+/*!
+ * Free buffers. Output isn't flushed.
+ */
+void proc_io_delete
+(
+	proc_io_t* io /*!< [in] buffers.                                         */
+);
+
+/*!
+ * Read value. Output is flushed before waiting for input.
+ *
+ * @return false if input is over or doesn't contain a number,
+ *         val is unchanged then.
+ */
+bool proc_io_read
+(
+	proc_io_t*         io, /*!< [in,out] buffers.                            */
+	processor_value_t* val /*!< [out]    read value.                         */
+);
+
+/*!
+ * Write value.
+ */
+void proc_io_write
+(
+	proc_io_t*        io, /*!< [in,out] buffers.                             */
+	processor_value_t val /*!< [in]     written value.                       */
+);
+
+/*!
+ * Write message followed by '\n'. In binary mode it is written
+ * in stderr, so it doesn't break frames.
+ */
+void proc_io_puts
+(
+	proc_io_t*  io, /*!< [in,out] buffers.                                   */
+	const char* str /*!< [in]     message.                                   */
+);
+
+/*!
+ * Write buffered output.
+ *
+ * @return false if output can't be written now or earlier.
+ */
+bool proc_io_flush
+(
+	proc_io_t* io /*!< [in,out] buffers.                                     */
+);
+
+
+
+
+#endif // ifndef PROC_IO_H_
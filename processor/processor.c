@@ -3,12 +3,16 @@
  * @brief Function's implementation for bin interpreteer.
  */
 
+#define _DEFAULT_SOURCE
 
 
 /*============================ Including headers ============================*/
 
 
 #include "processor.h"
+#include "jit.h"
+#include "analysis.h"
+#include "sandbox.h"
 #include "../libs/others.h"
 #include "../libs/logging.h"
 
@@ -17,6 +21,11 @@
 #include <string.h>
 #include <ctype.h>
 #include <math.h>
+#include <stdint.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 
 
 
@@ -24,270 +33,1670 @@
 /*======================== Macros & static functions ========================*/
 
 
-#define PUSH(VAL__)                                                           \
-{                                                                             \
-	processor_value_t TO_PUSH_ = VAL__;                                       \
-	stack_push(&proc->stack, &TO_PUSH_);                                      \
+/*
+ * Reserve memory of processor. Pages are committed by the kernel
+ * on first access, so untouched memory costs neither time nor RSS.
+ * Huge pages are taken from hugetlbfs if it has free pages, otherwise
+ * transparent huge pages are requested.
+ */
+static processor_value_t* mem_map (size_t* bytes, bool huge_pages,
+                                   bool sandbox)
+{
+	const int PROT  = PROT_READ | PROT_WRITE;
+	const int FLAGS = MAP_PRIVATE | MAP_ANONYMOUS;
+
+	*bytes = MEMORY_SIZE * sizeof (processor_value_t);
+	void* mem = MAP_FAILED;
+
+	if (sandbox)
+	{
+		size_t page   = (size_t) sysconf(_SC_PAGESIZE);
+		size_t usable = (*bytes + page - 1) / page * page;
+
+		*bytes = SANDBOX_SIZE;
+		mem    = mmap(NULL, *bytes, PROT_NONE, FLAGS | MAP_NORESERVE, -1, 0);
+		if (mem == MAP_FAILED)
+			return NULL;
+
+		if (mprotect(mem, usable, PROT) != 0)
+		{
+			munmap(mem, *bytes);
+			return NULL;
+		}
+
+		#ifdef MADV_HUGEPAGE
+			if (huge_pages)
+				madvise(mem, usable, MADV_HUGEPAGE);
+		#endif // defined MADV_HUGEPAGE
+
+		return (processor_value_t*) mem;
+	}
+
+	if (huge_pages)
+	{
+		*bytes = (*bytes + HUGE_PAGE_SIZE - 1) / HUGE_PAGE_SIZE * HUGE_PAGE_SIZE;
+
+		/* without MAP_NORESERVE mmap fails if hugetlbfs has no free
+		 * pages instead of raising SIGBUS on first access            */
+		#ifdef MAP_HUGETLB
+			mem = mmap(NULL, *bytes, PROT, FLAGS | MAP_HUGETLB, -1, 0);
+		#endif // defined MAP_HUGETLB
+	}
+
+	if (mem == MAP_FAILED)
+		mem = mmap(NULL, *bytes, PROT, FLAGS | MAP_NORESERVE, -1, 0);
+
+	if (mem == MAP_FAILED)
+		return NULL;
+
+	#ifdef MADV_HUGEPAGE
+		if (huge_pages)
+			madvise(mem, *bytes, MADV_HUGEPAGE);
+	#endif // defined MADV_HUGEPAGE
+
+	return (processor_value_t*) mem;
+}
+
+
+/*
+ * Arguments of run_engine() passed through sandbox_call().
+ */
+typedef struct engine_call_t_
+{
+	proc_state_t proc;
+	engine_t     engine;
+}
+engine_call_t;
+
+
+static void run_engine (void* arg)
+{
+	proc_state_t proc   = ((engine_call_t*) arg)->proc;
+	engine_t     engine = ((engine_call_t*) arg)->engine;
+
+	switch (engine)
+	{
+		#ifdef __GNUC__
+		case ENGINE_THREADED:
+			proc_run_threaded(proc);
+			break;
+
+		case ENGINE_CACHED:
+			proc_run_cached(proc);
+			break;
+		#endif // defined __GNUC__
+
+		case ENGINE_JIT:
+		{
+			/* helpers like redraw() report their errors themselves,
+			 * only errors of native code are reported here           */
+			proc_error_t err = jit_run(proc);
+			proc_io_flush(&proc->io);
+			if (err != NO_PROC_ERR && proc->error == NO_PROC_ERR)
+			{
+				proc->error = err;
+				print_error(err, "");
+			}
+			break;
+		}
+
+		case ENGINE_SWITCH:
+		default:
+			do
+				++proc->executed;
+			while (proc_process(proc));
+			break;
+	}
+}
+
+
+/*
+ * Write the rest of program's output and delete processor.
+ */
+static proc_error_t finish (proc_state_t proc)
+{
+	if (!proc_io_flush(&proc->io) && proc->error == NO_PROC_ERR)
+	{
+		proc->error = WRITE_ERR;
+		print_error(WRITE_ERR, "");
+	}
+
+	if (proc->render)
+	{
+		render_stop(proc->render, proc->mem, proc->dirty_rows,
+		            proc->fps ? stderr : NULL);
+		proc->render = NULL;
+	}
+
+	if (proc->capture)
+	{
+		bool captured = capture_close(proc->capture, stderr);
+		proc->capture = NULL;
+
+		if (!captured && proc->error == NO_PROC_ERR)
+		{
+			proc->error = WRITE_ERR;
+			print_error(WRITE_ERR, " Captured frames.");
+		}
+	}
+
+	proc_error_t err = proc->error;
+	proc_delete(proc);
+	return err;
+}
+
+
+#ifndef DEBUGGER
+
+/*
+ * Stop the execution because of stack error.
+ */
+static void stack_fault (proc_state_t proc, proc_error_t err)
+{
+	if (proc->error == NO_PROC_ERR)
+	{
+		proc->error = err;
+		proc_io_flush(&proc->io);
+		print_error(err, "");
+	}
+
+	proc->ip = proc->code_size;
+}
+
+#endif // ifndef DEBUGGER
+
+/*
+ * Superinstruction doesn't push values of the commands it replaces,
+ * so it checks that the stack has room for them to overflow
+ * at the same depth as these commands do.
+ */
+static inline bool stack_room (proc_state_t proc, size_t cached,
+                               size_t amount)
+{
+	#ifdef DEBUGGER
+		(void) proc;
+		(void) cached;
+		(void) amount;
+		return true;
+	#else
+		if (proc->stack.size + cached + amount <= proc->stack.capacity)
+			return true;
+
+		stack_fault(proc, STACK_OVERFLOW);
+		return false;
+	#endif // defined DEBUGGER
+}
+
+/*
+ * Operand stack functions check bounds only if checked is true.
+ * It is false in engines for programs whose stack depth is proven
+ * by analyze_stack_depth().
+ */
+
+#define PUSH(VAL__) PUSH_FUNC_(proc, VAL__, true)
+
+static inline void PUSH_FUNC_ (proc_state_t proc, processor_value_t val,
+                               bool checked)
+{
+	#ifdef DEBUGGER
+		(void) checked;
+		stack_push(&proc->stack, &val);
+	#else
+		if (checked && proc->stack.size == proc->stack.capacity)
+			stack_fault(proc, STACK_OVERFLOW);
+		else
+			proc->stack.data[proc->stack.size++] = val;
+	#endif // defined DEBUGGER
+}
+
+#define PUSH_ADDR(VAL__) PUSH_ADDR_FUNC_(proc, VAL__)
+
+static inline void PUSH_ADDR_FUNC_ (proc_state_t proc, addr_t addr)
+{
+	#ifdef DEBUGGER
+		stack_push(&proc->address_stack, &addr);
+	#else
+		if (proc->address_stack.size == proc->address_stack.capacity)
+			stack_fault(proc, STACK_OVERFLOW);
+		else
+			proc->address_stack.data[proc->address_stack.size++] = addr;
+	#endif // defined DEBUGGER
+}
+
+#define REG_A proc->regs[instr->reg]
+
+#define REG_B proc->regs[instr->reg2]
+
+#define IMM instr->imm
+
+/*
+ * Command breaks bounds of operand stack which analyze_stack_depth()
+ * computed. Only engines without stack checks react on it.
+ */
+#define STACK_UNPROVEN {}
+
+/*
+ * Command popped from empty operand stack, so stack_fault() stopped
+ * the program: handler is left before it writes anything.
+ */
+#define STACK_FAULT_EXIT                                                      \
+	if (proc->error != NO_PROC_ERR)                                           \
+		return 0;
+
+/*
+ * Superinstruction replaces commands which push N__ values at most.
+ */
+#define STACK_PEAK(N__)                                                       \
+	if (!stack_room(proc, 0, N__))                                            \
+		return 0;
+
+/*
+ * Commands with memory argument have separate handler for every mode
+ * of the argument, and handlers are chosen by full opcode (cmd | mode).
+ * This macro calls MACRO_(LABEL_, OPCODE_, MODE_, CODE_) for each mode.
+ */
+#define FOR_EACH_MODE_(MACRO_, NAME_, NUM_, CODE_)                            \
+	MACRO_(NAME_##_const,    NUM_,                      CONST_ARG,   CODE_)   \
+	MACRO_(NAME_##_reg,      NUM_ | REG_ARG,            REG_ARG,     CODE_)   \
+	MACRO_(NAME_##_addr,     NUM_ | ADDR_ARG,           ADDR_ARG,    CODE_)   \
+	MACRO_(NAME_##_reg_addr, NUM_ | REG_ARG | ADDR_ARG, REG_ARG | ADDR_ARG,   \
+	       CODE_)
+
+/*
+ * Handlers of commands with memory argument declare constant MODE,
+ * so writes through registers aren't checked at all.
+ */
+#define MARK_WRITTEN(PTR__) mark_written(proc, MODE, PTR__)
+
+static inline void mark_written (proc_state_t proc, unsigned char mode,
+                                 const processor_value_t* ptr)
+{
+	if (!(mode & ADDR_ARG))
+		return;
+
+	size_t index = (size_t) (ptr - proc->mem);
+	if (index < VIDEO_MEM_SIZE)
+		proc->dirty_rows[index / VIDEO_WIDTH] = 1;
+}
+
+#define POP POP_FUNC_(proc, true)
+
+static inline processor_value_t POP_FUNC_ (proc_state_t proc, bool checked)
+{
+	processor_value_t val = 0;
+	#ifdef DEBUGGER
+		(void) checked;
+		stack_pop(&proc->stack, &val);
+	#else
+		if (checked && proc->stack.size == 0)
+			stack_fault(proc, STACK_UNDERFLOW);
+		else
+			val = proc->stack.data[--proc->stack.size];
+	#endif // defined DEBUGGER
+	return val;
+}
+
+#define TOP TOP_FUNC_(proc, true)
+
+static inline processor_value_t TOP_FUNC_ (proc_state_t proc, bool checked)
+{
+	processor_value_t val = 0;
+	#ifdef DEBUGGER
+		(void) checked;
+		stack_top(&proc->stack, &val);
+	#else
+		if (checked && proc->stack.size == 0)
+			stack_fault(proc, STACK_UNDERFLOW);
+		else
+			val = proc->stack.data[proc->stack.size - 1];
+	#endif // defined DEBUGGER
+	return val;
+}
+
+#define POP_ADDR POP_ADDR_FUNC_(proc)
+
+static inline addr_t POP_ADDR_FUNC_ (proc_state_t proc)
+{
+	#ifdef DEBUGGER
+		addr_t addr;
+		if (stack_pop(&proc->address_stack, &addr) != STACK_OK)
+			return proc->code_size;
+
+		return addr;
+	#else
+		if (proc->address_stack.size == 0)
+			return proc->code_size;
+
+		return proc->address_stack.data[--proc->address_stack.size];
+	#endif // defined DEBUGGER
+}
+
+
+/*
+ * Cache functions work with the stack directly if cached is false.
+ */
+
+static inline void cache_push (proc_state_t proc, tos_cache_t* cache,
+                               processor_value_t val,
+                               bool cached, bool checked)
+{
+	if (!cached)
+	{
+		PUSH_FUNC_(proc, val, checked);
+		return;
+	}
+
+	#ifndef DEBUGGER
+		/* cached values take place in operand stack too              */
+		if (checked
+		    && proc->stack.size + cache->size == proc->stack.capacity)
+		{
+			stack_fault(proc, STACK_OVERFLOW);
+			return;
+		}
+	#endif // ifndef DEBUGGER
+
+	if (cache->size == 2)
+		PUSH_FUNC_(proc, cache->second, checked);
+	else
+		++cache->size;
+
+	cache->second = cache->top;
+	cache->top    = val;
+}
+
+
+static inline processor_value_t cache_pop (proc_state_t proc,
+                                           tos_cache_t* cache,
+                                           bool cached, bool checked)
+{
+	if (!cached)
+		return POP_FUNC_(proc, checked);
+
+	processor_value_t val = cache->top;
+	switch (cache->size)
+	{
+		case 2:
+			cache->top  = cache->second;
+			cache->size = 1;
+			return val;
+
+		case 1:
+			cache->size = 0;
+			return val;
+
+		default:
+			return POP_FUNC_(proc, checked);
+	}
+}
+
+
+static inline processor_value_t cache_top (proc_state_t proc,
+                                           tos_cache_t* cache,
+                                           bool cached, bool checked)
+{
+	if (!cached || cache->size == 0)
+		return TOP_FUNC_(proc, checked);
+
+	return cache->top;
+}
+
+
+static void cache_spill (proc_state_t proc, tos_cache_t* cache)
+{
+	if (cache->size == 2)
+		PUSH_FUNC_(proc, cache->second, true);
+
+	if (cache->size >= 1)
+		PUSH_FUNC_(proc, cache->top, true);
+
+	cache->size = 0;
+}
+
+
+static void read_bytes (proc_state_t proc, addr_t* pos, void* buff, size_t size)
+{
+	memcpy(buff, proc->instructions + *pos, size);
+	*pos += size;
+}
+
+
+static bool find_instr_index (const addr_t* addrs, size_t size,
+                              addr_t addr, addr_t* index)
+{
+	size_t left  = 0;
+	size_t right = size;
+
+	while (left < right)
+	{
+		size_t mid = (left + right) / 2;
+		if (addrs[mid] < addr)
+			left = mid + 1;
+		else
+			right = mid;
+	}
+
+	*index = left;
+	return left < size && addrs[left] == addr;
+}
+
+
+#define DEF_CMD(NAME_, NUM_, ARGS_, ...)                                      \
+	case NUM_:                                                                \
+		return ARGS_;
+
+static int cmd_arg_type (unsigned char cmd)
+{
+	switch (cmd)
+	{
+		#include "../DEF_CMD"
+		default:
+			return -1;
+	}
+}
+
+#undef DEF_CMD
+
+
+/*
+ * Bits which verify_program() sets on bytes of the image.
+ */
+enum image_mark_t_
+{
+	MARK_INSTR  = 1 << 0, /* instruction begins here.                        */
+	MARK_TARGET = 1 << 1, /* instruction has label argument.                 */
+};
+
+
+static size_t verify_error (proc_state_t proc, proc_error_t err, addr_t pos)
+{
+	char pos_str[MAX_TOKEN_SIZE];
+	sprintf(pos_str, "(byte %llu)", pos);
+	proc->error = err;
+	print_error(err, pos_str);
+	return 0;
+}
+
+
+/*
+ * Check instruction at pos and return its length or 0 if it is wrong.
+ * Marks of the instruction are set in mark.
+ */
+static size_t verify_instruction (proc_state_t proc, addr_t pos,
+                                  unsigned char* mark)
+{
+	const unsigned char* image    = proc->instructions + pos;
+	unsigned char        cmd      = image[0] & ~(ADDR_ARG | REG_ARG);
+	unsigned char        mode     = image[0] &  (ADDR_ARG | REG_ARG);
+	int                  arg_type = cmd_arg_type(cmd);
+	size_t               len      = 1;
+
+	if (arg_type < 0 || (arg_type != MEMORY_ARG && mode != CONST_ARG))
+		return verify_error(proc, UNKNOWN_INSTR, pos);
+
+	if (arg_type == LABEL_ARG)
+		len += sizeof (addr_t);
+	else if (arg_type == MEMORY_ARG)
+	{
+		len += (mode & REG_ARG)  ? sizeof (reg_t) : sizeof (processor_value_t);
+		len += (mode & ADDR_ARG) ? sizeof (addr_t) : 0;
+	}
+
+	if (len > proc->instr_size - pos)
+		return verify_error(proc, WRONG_ARG, pos);
+
+	if (arg_type == MEMORY_ARG && (mode & REG_ARG) && image[1] >= REGS_NUMBER)
+		return verify_error(proc, WRONG_REG, pos);
+
+	/* pop and in write their argument, so it can't be constant          */
+	if ((cmd == cmd_pop || cmd == cmd_in) && mode == CONST_ARG)
+		return verify_error(proc, WRONG_ARG, pos);
+
+	if (mode == ADDR_ARG)
+	{
+		processor_value_t addr   = 0;
+		addr_t            offset = 0;
+		memcpy(&addr,   image + 1, sizeof addr);
+		memcpy(&offset, image + 1 + sizeof addr, sizeof offset);
+		addr += (processor_value_t) offset;
+
+		if (addr < 0 || (addr_t) addr >= MEMORY_SIZE)
+			return verify_error(proc, WRONG_ARG, pos);
+	}
+
+	*mark |= MARK_INSTR;
+	if (arg_type == LABEL_ARG)
+		*mark |= MARK_TARGET;
+
+	return len;
+}
+
+
+#ifndef DEBUGGER
+
+static bool is_regular_file (FILE* input)
+{
+	struct stat info = {};
+	return fstat(fileno(input), &info) == 0 && S_ISREG(info.st_mode);
+}
+
+
+/*
+ * Read available bytes of the image. Sets stream->eof at its end.
+ */
+static int stream_receive (proc_state_t proc)
+{
+	stream_t* stream = proc->stream;
+
+	if (proc->instr_size + STREAM_CHUNK_SIZE > stream->capacity)
+	{
+		size_t         capacity = stream->capacity * 2 + STREAM_CHUNK_SIZE;
+		unsigned char* buff     = (unsigned char*) realloc(stream->buff,
+		                                                   capacity);
+		if (!buff)
+		{
+			proc->error = ALLOC_ERR;
+			print_error(ALLOC_ERR, "received image");
+			return 0;
+		}
+
+		stream->buff       = buff;
+		stream->capacity   = capacity;
+		proc->instructions = buff;
+	}
+
+	ssize_t received = 0;
+	do
+		received = read(stream->fd, stream->buff + proc->instr_size,
+		                stream->capacity - proc->instr_size);
+	while (received < 0 && errno == EINTR);
+
+	if (received < 0)
+	{
+		proc->error = READ_ERR;
+		print_error(READ_ERR, "");
+		return 0;
+	}
+
+	if (received == 0)
+		stream->eof = true;
+
+	proc->instr_size += (size_t) received;
+	return 1;
+}
+
+
+/*
+ * Reserve place for the next instruction and zeroed hit after it.
+ */
+static int stream_reserve (proc_state_t proc)
+{
+	stream_t* stream = proc->stream;
+	if (proc->code_size + 2 <= stream->code_capacity)
+		return 1;
+
+	size_t   capacity = stream->code_capacity * 2 + 64;
+	instr_t* code     = (instr_t*) realloc(proc->code,
+	                                       capacity * sizeof *code);
+	if (code)
+		proc->code = code;
+
+	addr_t* addrs = (addr_t*) realloc(stream->addrs, capacity * sizeof *addrs);
+	if (addrs)
+		stream->addrs = addrs;
+
+	if (!code || !addrs)
+	{
+		proc->error = ALLOC_ERR;
+		print_error(ALLOC_ERR, "decoded instructions");
+		return 0;
+	}
+
+	stream->code_capacity = capacity;
+	return 1;
+}
+
+
+/*
+ * Replace target of instruction by index of decoded instruction
+ * or mark it by PENDING_TARGET if it isn't decoded yet.
+ */
+static int stream_resolve (proc_state_t proc, size_t index)
+{
+	stream_t* stream = proc->stream;
+	instr_t*  instr  = proc->code + index;
+	addr_t    target = instr->target & ~PENDING_TARGET;
+
+	/* the whole image is decoded only at its end                       */
+	bool complete = stream->eof && stream->decoded == proc->instr_size;
+	if (target >= stream->decoded && !complete)
+	{
+		if (instr->target & PENDING_TARGET)
+			return 1;
+
+		if (stream->pending_amount == stream->pending_capacity)
+		{
+			size_t  capacity = stream->pending_capacity * 2 + 16;
+			size_t* pending  = (size_t*) realloc(stream->pending,
+			                                     capacity * sizeof *pending);
+			if (!pending)
+			{
+				proc->error = ALLOC_ERR;
+				print_error(ALLOC_ERR, "pending targets");
+				return 0;
+			}
+
+			stream->pending          = pending;
+			stream->pending_capacity = capacity;
+		}
+
+		instr->target = PENDING_TARGET | target;
+		stream->pending[stream->pending_amount++] = index;
+		return 1;
+	}
+
+	/* label at the end of the input is the hit sentinel after it      */
+	if (complete && target == proc->instr_size)
+	{
+		instr->target = proc->code_size;
+		return 1;
+	}
+
+	if (!find_instr_index(stream->addrs, proc->code_size, target,
+	                      &instr->target))
+	{
+		char pos_str[MAX_TOKEN_SIZE];
+		sprintf(pos_str, "%llu (byte %llu)", target, stream->addrs[index]);
+		proc->error = UNKNOWN_LABEL;
+		print_error(UNKNOWN_LABEL, pos_str);
+		return 0;
+	}
+
+	return 1;
+}
+
+#endif // ifndef DEBUGGER
+
+
+static bool is_push_reg (const instr_t* instr)
+{
+	return instr->cmd == cmd_push && instr->mode == REG_ARG;
+}
+
+
+static bool is_push_const (const instr_t* instr)
+{
+	return instr->cmd == cmd_push && instr->mode == CONST_ARG;
+}
+
+
+static bool is_pop_reg (const instr_t* instr)
+{
+	return instr->cmd == cmd_pop && instr->mode == REG_ARG;
+}
+
+
+static bool is_cond_jump (const instr_t* instr)
+{
+	return cmd_je <= instr->cmd && instr->cmd <= cmd_jna;
+}
+
+
+static bool can_fuse (const bool* is_target, size_t avail, size_t len)
+{
+	if (avail < len)
+		return false;
+
+	for (size_t i = 1; i < len; ++i)
+		if (is_target[i])
+			return false;
+
+	return true;
+}
+
+
+static size_t fuse_at (instr_t* code, size_t avail, const bool* is_target)
+{
+	/* jumps with swapped operands: a OP b == b MIRRORED_OP a            */
+	static const unsigned char MIRRORED_JUMPS[] =
+	{
+		[cmd_je]  = cmd_je,
+		[cmd_jne] = cmd_jne,
+		[cmd_jb]  = cmd_ja,
+		[cmd_jnb] = cmd_jna,
+		[cmd_ja]  = cmd_jb,
+		[cmd_jna] = cmd_jnb,
+	};
+
+	instr_t fused = *code;
+
+	if (can_fuse(is_target, avail, 4) && is_pop_reg(code + 3)
+	    && (code[2].cmd == cmd_add || code[2].cmd == cmd_sub)
+	    && is_push_reg(code) && is_push_const(code + 1))
+	{
+		fused.cmd = (code[2].cmd == cmd_add) ? fused_add_rc_pop
+		                                     : fused_sub_rc_pop;
+		fused.reg  = code[0].reg;
+		fused.imm  = code[1].imm;
+		fused.reg2 = code[3].reg;
+		fused.len  = 4;
+	}
+	else if (can_fuse(is_target, avail, 4) && is_pop_reg(code + 3)
+	         && (code[2].cmd == cmd_add || code[2].cmd == cmd_sub)
+	         && is_push_const(code) && is_push_reg(code + 1))
+	{
+		/* REG_A - IMM is stored as (-IMM) + REG_A                       */
+		fused.cmd  = fused_add_rc_pop;
+		fused.reg  = code[1].reg;
+		fused.imm  = (code[2].cmd == cmd_add) ? code[0].imm
+		             : (processor_value_t) (0u - (unsigned) code[0].imm);
+		fused.reg2 = code[3].reg;
+		fused.len  = 4;
+	}
+	else if (can_fuse(is_target, avail, 3) && is_cond_jump(code + 2)
+	         && is_push_reg(code) && is_push_const(code + 1))
+	{
+		fused.cmd    = fused_je_rc + (code[2].cmd - cmd_je);
+		fused.reg    = code[0].reg;
+		fused.imm    = code[1].imm;
+		fused.target = code[2].target;
+		fused.len    = 3;
+	}
+	else if (can_fuse(is_target, avail, 3) && is_cond_jump(code + 2)
+	         && is_push_const(code) && is_push_reg(code + 1))
+	{
+		fused.cmd    = fused_je_rc + (MIRRORED_JUMPS[code[2].cmd] - cmd_je);
+		fused.reg    = code[1].reg;
+		fused.imm    = code[0].imm;
+		fused.target = code[2].target;
+		fused.len    = 3;
+	}
+	else if (can_fuse(is_target, avail, 3)
+	         && (code[2].cmd == cmd_add || code[2].cmd == cmd_sub
+	             || code[2].cmd == cmd_mul)
+	         && is_push_reg(code) && is_push_reg(code + 1))
+	{
+		fused.cmd  = (code[2].cmd == cmd_add) ? fused_add_rr
+		           : (code[2].cmd == cmd_sub) ? fused_sub_rr
+		                                      : fused_mul_rr;
+		fused.reg  = code[0].reg;
+		fused.reg2 = code[1].reg;
+		fused.len  = 3;
+	}
+	else if (can_fuse(is_target, avail, 2) && is_pop_reg(code + 1)
+	         && (is_push_const(code) || is_push_reg(code)))
+	{
+		fused.cmd  = is_push_const(code) ? fused_mov_c : fused_mov_r;
+		fused.reg2 = code[1].reg;
+		fused.len  = 2;
+	}
+	else
+		return 1;
+
+	fused.mode = CONST_ARG;
+	*code      = fused;
+	return fused.len;
+}
+
+
+/*
+ * Mode is constant in every handler, so only one case is left there.
+ */
+static inline void load_mem_arg (proc_state_t proc, const instr_t* instr,
+                                 unsigned char mode,
+                                 processor_value_t** val_ptr,
+                                 processor_value_t*  val)
+{
+	switch (mode)
+	{
+		case REG_ARG:
+			*val_ptr = proc->regs + instr->reg;
+			break;
+
+		case ADDR_ARG:
+			*val_ptr = proc->mem + (uint32_t) instr->imm;
+			break;
+
+		case REG_ARG | ADDR_ARG:
+			*val_ptr = proc->mem + ((uint32_t) proc->regs[instr->reg]
+			                        + (uint32_t) instr->imm);
+			break;
+
+		default:
+			*val_ptr = NULL;
+			*val     = instr->imm;
+			return;
+	}
+
+	*val = **val_ptr;
+}
+
+
+
+
+/*========================= Functions implementation ========================*/
+
+
+#ifdef DEBUGGER
+
+void print_last_elements_from_stack (proc_state_t proc, size_t amount)
+{
+	if (stack_size(&proc->stack) < amount)
+		amount = stack_size(&proc->stack);
+
+	processor_value_t elems[amount];
+	for (size_t i = 0; i < amount; ++i)
+		stack_pop(&proc->stack, elems + amount - i - 1);
+
+	for (size_t i = 0; i < amount; ++i)
+	{
+		printf("%d ", elems[i]);
+		stack_push(&proc->stack, elems + i);
+	}
+	putchar('\n');
+}
+
+
+void print_reg_value (proc_state_t proc, char reg_letter)
+{
+	size_t reg = reg_letter - 'a';
+	if (reg < REGS_NUMBER)
+		printf("%d\n", proc->regs[reg]);
+	else
+		puts("Wrong register number");
+}
+
+
+void print_mem (proc_state_t proc, addr_t from, addr_t to)
+{
+	for (addr_t i = from; i < to && i < MEMORY_SIZE; ++i)
+		printf("%d ", proc->mem[i]);
+	putchar('\n');
+}
+
+
+bool debugger_process (proc_state_t proc)
+{
+	size_t print_amount = 0;
+	char   reg_letter   = '\0';
+	addr_t from = 0, to = 0;
+	char   cmd = '\0';
+
+	/* program's output is shown before waiting for command           */
+	proc_io_flush(&proc->io);
+
+	while (true)
+	{
+		if ((cmd = getchar()) != EOF)
+		{
+			if (isalpha(cmd))
+				break;
+		}
+		else
+			return false;
+	}
+
+	cmd = toupper(cmd);
+	switch (cmd)
+	{
+		case 'S':
+			scanf("%zd", &print_amount);
+			print_last_elements_from_stack(proc, print_amount);
+			return true;
+
+		case 'R':
+			scanf(" %cx", &reg_letter);
+			print_reg_value(proc, reg_letter);
+			return true;
+
+		case 'M':
+			scanf("%llu %llu", &from, &to);
+			print_mem(proc, from, to);
+			return true;
+
+		case 'N':
+			return proc_process(proc);
+
+		case 'E':
+			return false;
+
+		default:
+			printf("Unknown debugger's command: %c.", cmd);
+			return true;
+	}
+}
+
+#endif // defined DEBUGGER
+	   //
+	   //
+proc_error_t run (FILE* input, const proc_options_t* options)
+{
+	if_log (is_bad_mem(input, sizeof *input), ERROR,
+		return ALLOC_ERR;)
+
+	if_log (is_bad_mem(options, sizeof *options), ERROR,
+		return ALLOC_ERR;)
+
+	proc_state_t proc = proc_init(input, options);
+	if (!proc)
+	{
+		print_error(ALLOC_ERR, "processor state");
+		return 1;
+	}
+
+	if (options->capture
+	    && !(proc->capture = capture_open(options->capture, options->delta)))
+	{
+		char str[MAX_FRAME_PATH_SIZE];
+		snprintf(str, sizeof str, " Capture: %s", options->capture);
+		print_error(WRITE_ERR, str);
+		proc_delete(proc);
+		return WRITE_ERR;
+	}
+
+	#ifndef DEBUGGER
+		if (proc->stream)
+		{
+			stream_run(proc);
+
+			if (options->count)
+				fprintf(stderr, "Executed instructions: %llu\n",
+				        proc->executed);
+
+			return finish(proc);
+		}
+	#endif // ifndef DEBUGGER
+
+	if (!check_signature(proc))
+	{
+		print_error(WRONG_SIGNATURE, "");
+		proc_delete(proc);
+		return WRONG_SIGNATURE;
+	}
+
+	if (!verify_program(proc) || !decode_program(proc))
+	{
+		proc_error_t err = proc->error;
+		proc_delete(proc);
+		return err;
+	}
+
+	#ifdef DEBUGGER
+		(void) options;
+		while (debugger_process(proc))
+			continue;
+	#else
+		if (!check_stack_depth(proc)
+		    || (options->fusion && options->engine != ENGINE_JIT
+		        && !fuse_instructions(proc)))
+		{
+			proc_error_t err = proc->error;
+			proc_delete(proc);
+			return err;
+		}
+
+		proc_run(proc, options->engine);
+
+		if (options->count)
+			fprintf(stderr, "Executed instructions: %llu\n", proc->executed);
+	#endif // defined DEBUGGER
+
+	return finish(proc);
+}
+
+
+int check_signature (proc_state_t proc)
+{
+	if_log (is_bad_mem(proc, sizeof *proc), ERROR,
+		return 0;)
+
+	if (proc->instr_size < sizeof SIGNATURE + sizeof VERSION)
+		return 0;
+
+	if (*(const signature_t*) proc->instructions != SIGNATURE)
+		return 0;
+
+	version_t version = *(const version_t*) (proc->instructions
+	                                         + sizeof SIGNATURE);
+	if (version != VERSION)
+	{
+		printf("Incompatible file version: %d > %d\n", version, VERSION);
+		return 0;
+	}
+
+	proc->ip += sizeof SIGNATURE + sizeof VERSION;
+
+	return 1;
+}
+
+
+proc_state_t proc_init (FILE* input, const proc_options_t* options)
+{
+	if_log (is_bad_mem(input, sizeof *input), ERROR,
+		return NULL;)
+
+	if_log (is_bad_mem(options, sizeof *options), ERROR,
+		return NULL;)
+
+	proc_state_t proc = (proc_state_t) calloc(1, sizeof *proc);
+	if (!proc)
+		return NULL;
+
+	#ifdef DEBUGGER
+		(void) options;
+		stack_constructor(proc->stack, processor_value_t);
+		stack_constructor(proc->address_stack, addr_t);
+	#else
+		size_t stack_bytes = options->stack_size * sizeof *proc->stack.data;
+		size_t call_bytes  = options->call_stack_size
+		                   * sizeof *proc->address_stack.data;
+
+		proc->stack.data             = (processor_value_t*) malloc(stack_bytes);
+		proc->stack.capacity         = options->stack_size;
+		proc->address_stack.data     = (addr_t*) malloc(call_bytes);
+		proc->address_stack.capacity = options->call_stack_size;
+
+		if (!proc->stack.data || !proc->address_stack.data)
+			return proc_delete(proc);
+	#endif // defined DEBUGGER
+
+	/* debugger has no fault handler */
+	#ifndef DEBUGGER
+		proc->sandbox = options->sandbox;
+	#endif // ifndef DEBUGGER
+
+	proc->mem = mem_map(&proc->mem_bytes, options->huge_pages, proc->sandbox);
+	if (!proc->mem)
+		return proc_delete(proc);
+
+	proc->ip = 0;
+	proc->stack_checks = true;
+	proc->headless = options->headless;
+	proc->fps = options->fps;
+	proc->error = NO_PROC_ERR;
+
+	/* the first drw shows the whole picture */
+	memset(proc->dirty_rows, 1, sizeof proc->dirty_rows);
+
+	if (!proc_io_init(&proc->io, STDIN_FILENO, STDOUT_FILENO,
+	                  options->binary_io))
+		return proc_delete(proc);
+
+	#ifndef DEBUGGER
+		if (options->stream || !is_regular_file(input))
+		{
+			proc->stream = (stream_t*) calloc(1, sizeof *proc->stream);
+			if (!proc->stream)
+				return proc_delete(proc);
+
+			proc->stream->fd = fileno(input);
+			return proc;
+		}
+	#endif // ifndef DEBUGGER
+	
+	proc->instructions = (const unsigned char*) map_file(input, &proc->instr_size,
+	                                                     &proc->instr_mapped);
+	if (!proc->instructions)
+		return proc_delete(proc);
+
+	return proc;
+}
+
+
+proc_state_t proc_delete (proc_state_t proc)
+{
+	if_log (is_bad_mem(proc, sizeof *proc), ERROR,
+		return NULL;)
+
+	#ifdef DEBUGGER
+		stack_deconstructor(&proc->stack);
+		stack_deconstructor(&proc->address_stack);
+	#else
+		free(proc->stack.data);
+		free(proc->address_stack.data);
+	#endif // defined DEBUGGER
+
+	unmap_file((const char*) proc->instructions, proc->instr_size,
+	           proc->instr_mapped);
+
+	proc_io_delete(&proc->io);
+
+	if (proc->capture)
+		capture_close(proc->capture, NULL);
+
+	if (proc->stream)
+	{
+		free(proc->stream->addrs);
+		free(proc->stream->pending);
+		free(proc->stream);
+	}
+
+	if (proc->code)
+		free(proc->code);
+
+	/* render thread shows video memory until the window is closed */
+	if (proc->render)
+		render_stop(proc->render, proc->mem, proc->dirty_rows, NULL);
+
+	if (proc->mem)
+		munmap(proc->mem, proc->mem_bytes);
+
+	if (proc->native)
+		munmap(proc->native, proc->native_size);
+
+	free(proc);
+	return NULL;
+}
+
+
+void proc_run (proc_state_t proc, engine_t engine)
+{
+	if_log (is_bad_mem(proc, sizeof *proc), ERROR,
+		return;)
+
+	engine_call_t call = { proc, engine };
+	if (!proc->sandbox)
+	{
+		run_engine(&call);
+		return;
+	}
+
+	const void* fault = NULL;
+	switch (sandbox_call(run_engine, &call, proc->mem,
+	                     (char*) proc->mem + proc->mem_bytes, &fault))
+	{
+		case SANDBOX_OK:
+			break;
+
+		case SANDBOX_FAULT:
+		{
+			char str[MAX_TOKEN_SIZE];
+			sprintf(str, " Index: %zu.",
+			        (size_t) ((const processor_value_t*) fault - proc->mem));
+
+			proc->error = MEM_FAULT;
+			proc_io_flush(&proc->io);
+			print_error(MEM_FAULT, str);
+			break;
+		}
+
+		case SANDBOX_NO_HANDLER:
+		default:
+			proc->error = ALLOC_ERR;
+			print_error(ALLOC_ERR, "sandbox signal handler");
+			break;
+	}
+}
+
+
+#ifdef __GNUC__
+
+#undef PUSH
+#undef POP
+#undef TOP
+#undef STACK_UNPROVEN
+#undef STACK_FAULT_EXIT
+#undef STACK_PEAK
+
+#define STACK_UNPROVEN                                                        \
+	if (!ENGINE_CHECKS_)                                                      \
+		goto stack_unproven;
+
+#define STACK_FAULT_EXIT                                                      \
+	if (ENGINE_CHECKS_ && proc->error != NO_PROC_ERR)                         \
+		goto end_of_code;
+
+#define STACK_PEAK(N__)                                                       \
+	if (ENGINE_CHECKS_ && !stack_room(proc, cache.size, N__))                 \
+		goto end_of_code;
+
+#define PUSH(VAL__) cache_push(proc, &cache, VAL__,                           \
+                               ENGINE_CACHED_, ENGINE_CHECKS_)
+#define POP         cache_pop(proc, &cache, ENGINE_CACHED_, ENGINE_CHECKS_)
+#define TOP         cache_top(proc, &cache, ENGINE_CACHED_, ENGINE_CHECKS_)
+
+#define ENGINE_NAME_   threaded_checked
+#define ENGINE_CACHED_ false
+#define ENGINE_CHECKS_ true
+#include "threaded_engine.h"
+
+#define ENGINE_NAME_   threaded_unchecked
+#define ENGINE_CACHED_ false
+#define ENGINE_CHECKS_ false
+#include "threaded_engine.h"
+
+#define ENGINE_NAME_   cached_checked
+#define ENGINE_CACHED_ true
+#define ENGINE_CHECKS_ true
+#include "threaded_engine.h"
+
+#define ENGINE_NAME_   cached_unchecked
+#define ENGINE_CACHED_ true
+#define ENGINE_CHECKS_ false
+#include "threaded_engine.h"
+
+#undef PUSH
+#undef POP
+#undef TOP
+#undef STACK_UNPROVEN
+#undef STACK_FAULT_EXIT
+#undef STACK_PEAK
+
+#define PUSH(VAL__) PUSH_FUNC_(proc, VAL__, true)
+#define POP         POP_FUNC_(proc, true)
+#define TOP         TOP_FUNC_(proc, true)
+
+#define STACK_UNPROVEN {}
+
+#define STACK_FAULT_EXIT                                                      \
+	if (proc->error != NO_PROC_ERR)                                           \
+		return 0;
+
+#define STACK_PEAK(N__)                                                       \
+	if (!stack_room(proc, 0, N__))                                            \
+		return 0;
+
+
+int proc_run_threaded (proc_state_t proc)
+{
+	if_log (is_bad_mem(proc, sizeof *proc), ERROR,
+		return 0;)
+
+	if (!proc->stack_checks && threaded_unchecked(proc) == 0)
+		return 0;
+
+	return threaded_checked(proc);
 }
 
-#define PUSH_ADDR(VAL__)                                                      \
-{                                                                             \
-	addr_t TO_PUSH_ = VAL__;                                                  \
-	stack_push(&proc->address_stack, &TO_PUSH_);                              \
+
+int proc_run_cached (proc_state_t proc)
+{
+	if_log (is_bad_mem(proc, sizeof *proc), ERROR,
+		return 0;)
+
+	if (!proc->stack_checks && cached_unchecked(proc) == 0)
+		return 0;
+
+	return cached_checked(proc);
 }
 
-#define POP POP_FUNC_(proc)
+#endif // defined __GNUC__
 
-static processor_value_t POP_FUNC_ (proc_state_t proc)
-{
-	processor_value_t val;
-	stack_pop(&proc->stack, &val);
-	return val;
-}
 
-#define TOP TOP_FUNC_(proc)
+#define CASES_NO_ARGS(NAME_, NUM_, CODE_)                                     \
+	case NUM_:                                                                \
+		CODE_;                                                                \
+		break;
 
-static processor_value_t TOP_FUNC_ (proc_state_t proc)
-{
-	processor_value_t val;
-	stack_top(&proc->stack, &val);
-	return val;
-}
+#define CASES_LABEL_ARG(NAME_, NUM_, CODE_)                                   \
+	case NUM_:                                                                \
+		CODE_;                                                                \
+		if (proc->error != NO_PROC_ERR)                                       \
+			proc->ip = proc->code_size;                                       \
+		break;
 
-#define POP_ADDR POP_ADDR_FUNC_(proc)
+#define CASE_MODE_(LABEL_, OPCODE_, MODE_, CODE_)                             \
+	case OPCODE_:                                                             \
+	{                                                                         \
+		enum { MODE = MODE_ };                                                \
+		load_mem_arg(proc, instr, MODE, &VAL_PTR, &VAL);                      \
+		CODE_;                                                                \
+		break;                                                                \
+	}
 
-static processor_value_t POP_ADDR_FUNC_ (proc_state_t proc)
-{
-	addr_t addr;
-	stack_pop(&proc->address_stack, &addr);
-	return addr;
-}
+#define CASES_MEMORY_ARG(NAME_, NUM_, CODE_)                                  \
+	FOR_EACH_MODE_(CASE_MODE_, NAME_, NUM_, CODE_)
 
+#define DEF_CMD(NAME_, NUM_, ARGS_, CODE_)                                    \
+	CASES_##ARGS_(NAME_, NUM_, CODE_)
 
+#define DEF_FUSED(NAME_, NUM_, CODE_)                                         \
+	case NUM_:                                                                \
+		proc->ip += instr->len - 1;                                           \
+		CODE_;                                                                \
+		break;
 
+int proc_process (proc_state_t proc)
+{
+	if_log (is_bad_mem(proc, sizeof *proc), ERROR,
+		return 0;)
 
-/*========================= Functions implementation ========================*/
+	const instr_t*     instr = proc->code + proc->ip++;
+	processor_value_t* VAL_PTR;
+	processor_value_t  VAL;
+	addr_t             ADDR  = instr->target;
+	
+	switch (instr->cmd | instr->mode)
+	{
+		#include "../DEF_CMD"
+		#include "../DEF_FUSED"
+		default:
+			proc->error = UNKNOWN_INSTR;
+			print_error(UNKNOWN_INSTR, "");
+			return 0;
+	}
 
+	return 1;
+}
 
-#ifdef DEBUGGER
+#undef DEF_CMD
+#undef DEF_FUSED
 
-void print_last_elements_from_stack (proc_state_t proc, size_t amount)
+
+int verify_program (proc_state_t proc)
 {
-	if (stack_size(&proc->stack) < amount)
-		amount = stack_size(&proc->stack);
+	if_log (is_bad_mem(proc, sizeof *proc), ERROR,
+		return 0;)
 
-	processor_value_t elems[amount];
-	for (size_t i = 0; i < amount; ++i)
-		stack_pop(&proc->stack, elems + amount - i - 1);
+	unsigned char* marks = (unsigned char*) calloc(proc->instr_size + 1,
+	                                               sizeof *marks);
+	if (!marks)
+	{
+		proc->error = ALLOC_ERR;
+		print_error(ALLOC_ERR, "verification");
+		return 0;
+	}
 
-	for (size_t i = 0; i < amount; ++i)
+	for (addr_t pos = proc->ip, len = 0; pos < proc->instr_size; pos += len)
 	{
-		printf("%d ", elems[i]);
-		stack_push(&proc->stack, elems + i);
+		if (!(len = verify_instruction(proc, pos, marks + pos)))
+		{
+			free(marks);
+			return 0;
+		}
 	}
-	putchar('\n');
-}
 
+	for (addr_t pos = proc->ip; pos < proc->instr_size; ++pos)
+	{
+		if (!(marks[pos] & MARK_TARGET))
+			continue;
 
-void print_reg_value (proc_state_t proc, char reg_letter)
-{
-	size_t reg = reg_letter - 'a';
-	if (reg < REGS_NUMBER)
-		printf("%d\n", proc->regs[reg]);
-	else
-		puts("Wrong register number");
-}
+		addr_t target = 0;
+		memcpy(&target, proc->instructions + pos + 1, sizeof target);
+		/* label at the end of the file is the end of the image       */
+		if (target == proc->instr_size)
+			continue;
 
+		if (target > proc->instr_size || !(marks[target] & MARK_INSTR))
+		{
+			char pos_str[MAX_TOKEN_SIZE];
+			sprintf(pos_str, "%llu (byte %llu)", target, pos);
+			proc->error = UNKNOWN_LABEL;
+			print_error(UNKNOWN_LABEL, pos_str);
+			free(marks);
+			return 0;
+		}
+	}
 
-void print_mem (proc_state_t proc, addr_t from, addr_t to)
-{
-	for (addr_t i = from; i < to && i < MEMORY_SIZE; ++i)
-		printf("%d ", proc->mem[i]);
-	putchar('\n');
+	free(marks);
+	return 1;
 }
 
 
-bool debugger_process (proc_state_t proc)
+int decode_program (proc_state_t proc)
 {
-	size_t print_amount = 0;
-	char   reg_letter   = '\0';
-	addr_t from = 0, to = 0;
-	char   cmd = '\0';
+	if_log (is_bad_mem(proc, sizeof *proc), ERROR,
+		return 0;)
 
-	while (true)
+	size_t   max_size = proc->instr_size - proc->ip;
+	addr_t*  addrs    = (addr_t*)  calloc(max_size + 1, sizeof *addrs);
+	proc->code        = (instr_t*) calloc(max_size + 1, sizeof *proc->code);
+	if (!addrs || !proc->code)
 	{
-		if ((cmd = getchar()) != EOF)
+		free(addrs);
+		proc->error = ALLOC_ERR;
+		print_error(ALLOC_ERR, "decoded instructions");
+		return 0;
+	}
+
+	addr_t pos = proc->ip;
+	size_t n   = 0;
+	while (pos < proc->instr_size)
+	{
+		addrs[n] = pos;
+		if (!decode_instruction(proc, &pos, proc->code + n))
 		{
-			if (isalpha(cmd))
-				break;
+			free(addrs);
+			return 0;
 		}
-		else
-			return false;
+		++n;
 	}
 
-	cmd = toupper(cmd);
-	switch (cmd)
+	/* targets are instruction boundaries after verify_program(),
+	 * label at the end of the file is the end of the image: it is
+	 * mapped to code[n]                                                */
+	addrs[n] = pos;
+	for (size_t i = 0; i < n; ++i)
 	{
-		case 'S':
-			scanf("%zd", &print_amount);
-			print_last_elements_from_stack(proc, print_amount);
-			return true;
+		if (cmd_arg_type(proc->code[i].cmd) == LABEL_ARG)
+			find_instr_index(addrs, n + 1, proc->code[i].target,
+			                 &proc->code[i].target);
+	}
 
-		case 'R':
-			scanf(" %cx", &reg_letter);
-			print_reg_value(proc, reg_letter);
-			return true;
+	/* code[n] stays zeroed, so it is hit which stops the processor     */
+	free(addrs);
+	proc->code_size = n;
+	proc->ip        = 0;
 
-		case 'M':
-			scanf("%llu %llu", &from, &to);
-			print_mem(proc, from, to);
-			return true;
+	return 1;
+}
 
-		case 'N':
-			return proc_process(proc);
 
-		case 'E':
-			return false;
+int check_stack_depth (proc_state_t proc)
+{
+	if_log (is_bad_mem(proc, sizeof *proc), ERROR,
+		return 0;)
 
-		default:
-			printf("Unknown debugger's command: %c.", cmd);
-			return true;
-	}
+	stack_depth_t depth = {};
+	if (!analyze_stack_depth(proc, &depth))
+		return 0;
+
+	#ifndef DEBUGGER
+		if (!depth.safe_pops || !depth.bounded)
+			return 1;
+
+		size_t capacity = (depth.max_depth > 0) ? depth.max_depth : 1;
+		processor_value_t* data = (processor_value_t*)
+		                          realloc(proc->stack.data,
+		                                  capacity * sizeof *data);
+		if (!data)
+			return 1;
+
+		proc->stack.data     = data;
+		proc->stack.capacity = capacity;
+		proc->stack_checks   = false;
+	#endif // ifndef DEBUGGER
+
+	return 1;
 }
 
-#endif // defined DEBUGGER
-	   //
-	   //
-proc_error_t run (FILE* input)
+
+#ifndef DEBUGGER
+
+int stream_fill (proc_state_t proc)
 {
-	if_log (is_bad_mem(input, sizeof *input), ERROR,
-		return ALLOC_ERR;)
+	if_log (is_bad_mem(proc, sizeof *proc), ERROR,
+		return 0;)
 
-	proc_state_t proc = proc_init(input);
-	if (!proc)
+	stream_t* stream = proc->stream;
+	if (!stream_receive(proc))
+		return 0;
+
+	while (stream->decoded < proc->instr_size)
 	{
-		print_error(ALLOC_ERR, "processor state");
-		return 1;
+		/* instruction may be cut by the end of received part         */
+		if (proc->instr_size - stream->decoded < MAX_INSTR_SIZE
+		    && !stream->eof)
+			break;
+
+		unsigned char mark = 0;
+		addr_t        pos  = stream->decoded;
+		if (!stream_reserve(proc) || !verify_instruction(proc, pos, &mark))
+			return 0;
+
+		size_t index = proc->code_size;
+		stream->addrs[index] = pos;
+		if (!decode_instruction(proc, &pos, proc->code + index))
+			return 0;
+
+		stream->decoded = pos;
+		proc->code_size = index + 1;
+		memset(proc->code + proc->code_size, 0, sizeof *proc->code);
+
+		if ((mark & MARK_TARGET) && !stream_resolve(proc, index))
+			return 0;
 	}
 
-	if (!check_signature(proc))
+	size_t left = 0;
+	for (size_t i = 0; i < stream->pending_amount; ++i)
 	{
-		print_error(WRONG_SIGNATURE, "");
-		return WRONG_SIGNATURE;
-	}
+		size_t index = stream->pending[i];
+		if (!stream_resolve(proc, index))
+			return 0;
 
-	#ifdef DEBUGGER
-		while (debugger_process(proc))
-			continue;
-	#else
-		while (proc_process(proc))
-			continue;
-	#endif // defined DEBUGGER
+		if (proc->code[index].target & PENDING_TARGET)
+			stream->pending[left++] = index;
+	}
 
-	proc_error_t err = proc->error;
-	proc_delete(proc);
-	return err;
+	stream->pending_amount = left;
+	return 1;
 }
 
 
-int check_signature (proc_state_t proc)
+int stream_reach (proc_state_t proc)
 {
 	if_log (is_bad_mem(proc, sizeof *proc), ERROR,
 		return 0;)
 
-	if (proc->instr_size < sizeof SIGNATURE + sizeof VERSION)
-		return 0;
-
-	if (*(signature_t*) proc->instructions != SIGNATURE)
-		return 0;
+	stream_t* stream = proc->stream;
 
-	version_t version = *(version_t*) (proc->instructions + sizeof SIGNATURE);
-	if (version != VERSION)
+	if (proc->ip & PENDING_TARGET)
 	{
-		printf("Incompatible file version: %d > %d\n", version, VERSION);
-		return 0;
+		addr_t target = proc->ip & ~PENDING_TARGET;
+		while (target >= stream->decoded && !stream->eof)
+		{
+			if (!stream_fill(proc))
+				return 0;
+		}
+
+		/* label at the end of the input stops the program, other
+		 * wrong targets are reported by stream_fill()                 */
+		if (stream->eof && target == proc->instr_size)
+			proc->ip = proc->code_size;
+		else if (!find_instr_index(stream->addrs, proc->code_size,
+		                           target, &proc->ip))
+			return 0;
 	}
 
-	proc->ip += sizeof SIGNATURE + sizeof VERSION;
+	while (proc->ip >= proc->code_size && !stream->eof)
+	{
+		if (!stream_fill(proc))
+			return 0;
+	}
 
-	return 1;
+	return proc->ip < proc->code_size;
 }
 
 
-proc_state_t proc_init (FILE* input)
+void stream_run (proc_state_t proc)
 {
-	if_log (is_bad_mem(input, sizeof *input), ERROR,
-		return NULL;)
+	if_log (is_bad_mem(proc, sizeof *proc), ERROR,
+		return;)
 
-	proc_state_t proc = (proc_state_t) calloc(1, sizeof *proc);
-	if (!proc)
-		return NULL;
+	while (proc->instr_size < sizeof SIGNATURE + sizeof VERSION
+	       && !proc->stream->eof)
+	{
+		if (!stream_receive(proc))
+			return;
+	}
 
-	stack_constructor(proc->stack, processor_value_t);
-	stack_constructor(proc->address_stack, addr_t);
+	if (!check_signature(proc))
+	{
+		proc->error = WRONG_SIGNATURE;
+		print_error(WRONG_SIGNATURE, "");
+		return;
+	}
 
-	proc->ip = 0;
-	proc->error = NO_PROC_ERR;
-	
-	proc->instructions = (unsigned char*) read_file(input, &proc->instr_size);
-	if (!proc->instructions)
-		return proc_delete(proc);
+	proc->stream->decoded = proc->ip;
+	proc->ip              = 0;
 
-	return proc;
+	while (proc->error == NO_PROC_ERR && stream_reach(proc))
+	{
+		/* ret with empty call stack ends the program like in other
+		 * engines, it mustn't wait for the rest of the image          */
+		if (proc->code[proc->ip].cmd == cmd_ret
+		    && proc->address_stack.size == 0)
+			break;
+
+		++proc->executed;
+		if (!proc_process(proc))
+			break;
+	}
 }
 
+#endif // ifndef DEBUGGER
 
-proc_state_t proc_delete (proc_state_t proc)
+
+int fuse_instructions (proc_state_t proc)
 {
 	if_log (is_bad_mem(proc, sizeof *proc), ERROR,
-		return NULL;)
-
-	stack_deconstructor(&proc->stack);
-	stack_deconstructor(&proc->address_stack);
+		return 0;)
 
-	if (proc->instructions)
-		free(proc->instructions);
+	bool* is_target = (bool*) calloc(proc->code_size + 1, sizeof *is_target);
+	if (!is_target)
+	{
+		proc->error = ALLOC_ERR;
+		print_error(ALLOC_ERR, "superinstructions");
+		return 0;
+	}
 
-	if (proc->window)
+	for (size_t i = 0; i < proc->code_size; ++i)
 	{
-		SDL_Event event;
-		while (!(SDL_PollEvent(&event) && event.type == SDL_QUIT))
-			continue;
+		if (cmd_arg_type(proc->code[i].cmd) == LABEL_ARG)
+			is_target[proc->code[i].target] = true;
 
-		SDL_DestroyRenderer(proc->renderer);
-		SDL_DestroyWindow(proc->window);
-		SDL_Quit();
+		if (proc->code[i].cmd == cmd_call)
+			is_target[i + 1] = true;
 	}
-	free(proc);
-	return NULL;
+
+	for (size_t i = 0; i < proc->code_size; )
+		i += fuse_at(proc->code + i, proc->code_size - i, is_target + i);
+
+	free(is_target);
+	return 1;
 }
 
 
-#define DEF_CMD(NAME_, NUM_, ARGS_, CODE_)                                    \
+#define DEF_CMD(NAME_, NUM_, ARGS_, ...)                                      \
 	case NUM_:                                                                \
-		if (!get_arg(proc, instruction, ARGS_, &ADDR, &VAL_PTR, &VAL))        \
+		if (!get_arg(proc, pos, instruction, ARGS_, decoded))                 \
 		{                                                                     \
 			proc->error = WRONG_ARG;                                          \
 			print_error(WRONG_ARG, #NAME_);                                   \
 			return 0;                                                         \
 		}                                                                     \
-		CODE_;                                                                \
 		break;
 
-int proc_process (proc_state_t proc)
+int decode_instruction (proc_state_t proc, addr_t* pos, instr_t* decoded)
 {
 	if_log (is_bad_mem(proc, sizeof *proc), ERROR,
 		return 0;)
 
-	if (proc->ip >= proc->instr_size)
-		return 0;
+	if_log (is_bad_mem(decoded, sizeof *decoded), ERROR,
+		return 0;)
 
-	processor_value_t* VAL_PTR;
-	processor_value_t  VAL;
-	addr_t             ADDR;
-	unsigned char      instruction = proc->instructions[proc->ip++];
-	
-	switch (instruction & (~(unsigned char) ADDR_ARG) & (~(unsigned char) REG_ARG))
+	unsigned char instruction = proc->instructions[(*pos)++];
+
+	decoded->cmd    = instruction & (~(unsigned char) ADDR_ARG)
+	                              & (~(unsigned char) REG_ARG);
+	decoded->mode   = instruction & (ADDR_ARG | REG_ARG);
+	decoded->reg    = REG_ax;
+	decoded->reg2   = REG_ax;
+	decoded->imm    = 0;
+	decoded->target = 0;
+	decoded->len    = 1;
+
+	switch (decoded->cmd)
 	{
 		#include "../DEF_CMD"
 		default:
@@ -302,16 +1711,16 @@ int proc_process (proc_state_t proc)
 #undef DEF_CMD
 
 
-int get_arg (proc_state_t proc, char instr, arg_t arg_type,
-             addr_t* addr, processor_value_t** val_ptr, processor_value_t* val)
+int get_arg (proc_state_t proc, addr_t* pos, unsigned char instr,
+             arg_t arg_type, instr_t* decoded)
 {
 	if_log (is_bad_mem(proc, sizeof *proc), ERROR,
 		return 0;)
 
-	if_log (is_bad_mem(val_ptr, sizeof *val_ptr), ERROR,
+	if_log (is_bad_mem(pos, sizeof *pos), ERROR,
 		return 0;)
 
-	if_log (is_bad_mem(val, sizeof *val), ERROR,
+	if_log (is_bad_mem(decoded, sizeof *decoded), ERROR,
 		return 0;)
 
 	char arg_type_str[MAX_TOKEN_SIZE];
@@ -321,10 +1730,10 @@ int get_arg (proc_state_t proc, char instr, arg_t arg_type,
 			return 1;
 
 		case LABEL_ARG:
-			return get_label_arg(proc, addr);
+			return get_label_arg(proc, pos, decoded);
 
 		case MEMORY_ARG:
-			return get_mem_arg(proc, instr, val_ptr, val);
+			return get_mem_arg(proc, pos, instr, decoded);
 
 		default:
 			sprintf(arg_type_str, "%u", arg_type);
@@ -334,77 +1743,39 @@ int get_arg (proc_state_t proc, char instr, arg_t arg_type,
 }
 
 
-int get_label_arg (proc_state_t proc, addr_t* addr)
+int get_label_arg (proc_state_t proc, addr_t* pos, instr_t* decoded)
 {
 	if_log (is_bad_mem(proc, sizeof *proc), ERROR,
 		return 0;)
 
-	if_log (is_bad_mem(addr, sizeof *addr), ERROR,
+	if_log (is_bad_mem(decoded, sizeof *decoded), ERROR,
 		return 0;)
 
-	if (proc->ip + sizeof *addr > proc->instr_size)
-		return 0;
-
-	memcpy(addr, proc->instructions + proc->ip, sizeof *addr);
-	proc->ip += sizeof *addr;
-
+	read_bytes(proc, pos, &decoded->target, sizeof decoded->target);
 	return 1;
 }
 
 
-int get_mem_arg (proc_state_t proc, char instr,
-                 processor_value_t** val_ptr, processor_value_t* val)
+int get_mem_arg (proc_state_t proc, addr_t* pos, unsigned char instr,
+                 instr_t* decoded)
 {
 	if_log (is_bad_mem(proc, sizeof *proc), ERROR,
 		return 0;)
 
-	if_log (is_bad_mem(val_ptr, sizeof *val_ptr), ERROR,
+	if_log (is_bad_mem(decoded, sizeof *decoded), ERROR,
 		return 0;)
 
-	if_log (is_bad_mem(val, sizeof *val), ERROR,
-		return 0;)
+	addr_t offset = 0;
 
 	if (instr & REG_ARG)
-	{
-		reg_t reg;
-		if (proc->ip + sizeof reg > proc->instr_size)
-			return 0;
-
-		memcpy(&reg, proc->instructions + proc->ip, sizeof reg);
-		*val_ptr  = proc->regs + reg;
-		*val      = **val_ptr;
-		proc->ip += sizeof reg;
-		
-		if (instr & ADDR_ARG)
-		{
-			addr_t offset = 0;
-			memcpy(&offset, proc->instructions + proc->ip, sizeof offset);
-			proc->ip += sizeof offset;
-			*val_ptr = proc->mem + *val + offset;
-			*val     = **val_ptr;
-		}
-	}
-	else if (instr & ADDR_ARG)
-	{
-		processor_value_t addr   = 0;
-		addr_t            offset = 0;
-		if (proc->ip + sizeof addr > proc->instr_size)
-			return 0;
-
-		memcpy(&addr, proc->instructions + proc->ip, sizeof addr);
-		memcpy(&offset, proc->instructions + proc->ip, sizeof offset);
-		*val_ptr  = proc->mem + addr + offset;
-		*val      = **val_ptr;
-		proc->ip += sizeof addr + sizeof offset;
-	}
+		read_bytes(proc, pos, &decoded->reg, sizeof decoded->reg);
 	else
-	{
-		if (proc->ip + sizeof *val > proc->instr_size)
-			return 0;
+		read_bytes(proc, pos, &decoded->imm, sizeof decoded->imm);
 
-		memcpy(val, proc->instructions + proc->ip, sizeof *val);
-		*val_ptr  = NULL;
-		proc->ip += sizeof *val;
+	if (instr & ADDR_ARG)
+	{
+		read_bytes(proc, pos, &offset, sizeof offset);
+		decoded->imm += (processor_value_t) offset;
 	}
 
 	return 1;
@@ -413,25 +1784,30 @@ int get_mem_arg (proc_state_t proc, char instr,
 
 void redraw (proc_state_t proc)
 {
-	if (!proc->window)
+	if (proc->capture)
 	{
-		SDL_Init(SDL_INIT_EVERYTHING);
-		SDL_CreateWindowAndRenderer(VIDEO_WIDTH, VIDEO_HEIGHT, 0,
-		                            &proc->window, &proc->renderer);
+		if (!capture_frame(proc->capture, proc->mem, proc->dirty_rows)
+		    && proc->error == NO_PROC_ERR)
+		{
+			proc->error = WRITE_ERR;
+			print_error(WRITE_ERR, " Captured frames.");
+		}
+
+		memset(proc->dirty_rows, 0, sizeof proc->dirty_rows);
+		return;
 	}
 
-	SDL_SetRenderDrawColor(proc->renderer, 0, 0, 0, 255);
-	SDL_RenderClear(proc->renderer);
-	SDL_SetRenderDrawColor(proc->renderer, 255, 255, 255, 255);
+	if (proc->headless)
+		return;
 
-	for (addr_t i = 0; i < VIDEO_HEIGHT; ++i)
+	/* window is opened by render thread, drw only publishes picture */
+	if (!proc->render && !(proc->render = render_start(proc->fps)))
 	{
-		for (addr_t j = 0; j < VIDEO_WIDTH; ++j)
-		{
-			if (proc->mem[i * VIDEO_WIDTH + j])
-				SDL_RenderDrawPoint(proc->renderer, i, j);
-		}
+		proc->headless = true;
+		return;
 	}
 
-	SDL_RenderPresent(proc->renderer);
+	/* coalesced drw keeps dirty rows for the next one */
+	if (render_publish(proc->render, proc->mem, proc->dirty_rows))
+		memset(proc->dirty_rows, 0, sizeof proc->dirty_rows);
 }
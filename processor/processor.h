@@ -17,6 +17,9 @@
 #include "../errors/errors.h"
 #include "../commands.h"
 #include "../libs/secure_stack.h"
+#include "proc_io.h"
+#include "capture.h"
+#include "render.h"
 
 #include <stdio.h>
 #include <stdbool.h>
@@ -25,27 +28,235 @@
 
 
 
+/*=========================== Constants declaration =========================*/
+
+/*!
+ * Default capacity of operand stack in values.
+ */
+#define DEFAULT_STACK_SIZE (size_t) (1 << 20)
+
+/*!
+ * Default capacity of call stack in return points.
+ */
+#define DEFAULT_CALL_STACK_SIZE (size_t) (1 << 20)
+
+/*!
+ * Size of huge page which memory is aligned to with --huge-pages.
+ */
+#define HUGE_PAGE_SIZE (size_t) (2 << 20)
+
+/*!
+ * Size of address space reserved for memory with --sandbox. Memory
+ * indices are 32-bit unsigned, so every index falls into this region.
+ */
+#define SANDBOX_SIZE (size_t) ((1ULL << 32) * sizeof (processor_value_t))
+
+/*!
+ * Max length of encoded instruction: command, constant and offset.
+ */
+#define MAX_INSTR_SIZE (size_t) (1 + sizeof (processor_value_t) + sizeof (addr_t))
+
+/*!
+ * Amount of bytes which streaming loader asks from input at once.
+ */
+#define STREAM_CHUNK_SIZE (size_t) (1 << 16)
+
+/*!
+ * Bit of jump target which hasn't been received yet. The rest of
+ * the target is its position in the image.
+ */
+#define PENDING_TARGET ((addr_t) 1 << 63)
+
+
+
+
 /*============================ Types declaration ============================*/
 
+/*!
+ * Instruction decoded from .pegas image.
+ *
+ * All operands are resolved at load time, so executing instruction
+ * doesn't need to read the image.
+ */
+typedef struct instr_t_
+{
+	const void*       handler; /*!< address of command's handler in 
+	                                threaded engine.                         */
+	addr_t            target;  /*!< index of jump target in decoded code.    */
+	processor_value_t imm;     /*!< constant, address or address offset.     */
+	unsigned char     cmd;     /*!< command number without argument bits.    */
+	unsigned char     mode;    /*!< memory argument type bits.               */
+	reg_t             reg;     /*!< register index.                          */
+	reg_t             reg2;    /*!< second register of superinstruction.     */
+	unsigned char     len;     /*!< amount of commands which are replaced 
+	                                by this instruction.                     */
+}
+instr_t;
+
+#define DEF_FUSED(NAME_, NUM_, ...) fused_##NAME_ = NUM_,
+/*!
+ * Enum with superinstructions.
+ */
+typedef enum fused_t_
+{
+	#include "../DEF_FUSED" /*   e.g. fused_add_rc_pop = 32                  */
+}
+fused_t;
+#undef DEF_FUSED
+
+/*!
+ * List of execution engines.
+ */
+typedef enum engine_t_
+{
+	ENGINE_SWITCH   = 0, /*!< switch over commands in proc_process().        */
+	ENGINE_THREADED = 1, /*!< direct-threaded code using computed goto.      */
+	ENGINE_JIT      = 2, /*!< native x86-64 code.                            */
+	ENGINE_CACHED   = 3, /*!< direct-threaded code which keeps top
+	                          of operand stack in local variables.           */
+}
+engine_t;
+
+/*!
+ * Top values of operand stack which are kept out of memory.
+ *
+ * If size is 2 top is above second, if size is 1 only top is used.
+ * Values below them are in proc->stack.
+ */
+typedef struct tos_cache_t_
+{
+	processor_value_t top;    /*!< top value of operand stack.               */
+	processor_value_t second; /*!< value below the top one.                  */
+	unsigned char     size;   /*!< amount of cached values.                  */
+}
+tos_cache_t;
+
+/*!
+ * Operand stack with fixed capacity which is allocated once.
+ */
+typedef struct value_stack_t_
+{
+	processor_value_t* data;     /*!< values.                                */
+	size_t             size;     /*!< amount of values.                      */
+	size_t             capacity; /*!< max amount of values.                  */
+}
+value_stack_t;
+
+/*!
+ * Call stack with fixed capacity which is allocated once.
+ */
+typedef struct call_stack_t_
+{
+	addr_t* data;     /*!< indices of return points.                         */
+	size_t  size;     /*!< amount of return points.                          */
+	size_t  capacity; /*!< max amount of return points.                      */
+}
+call_stack_t;
+
+/*!
+ * State of loader which decodes the image while it is being received.
+ *
+ * proc->instructions and proc->instr_size describe received bytes,
+ * proc->code and proc->code_size describe decoded instructions.
+ */
+typedef struct stream_t_
+{
+	int            fd;               /*!< input descriptor.                  */
+	bool           eof;              /*!< whole image is received.           */
+	unsigned char* buff;             /*!< received bytes. It is freed
+	                                      as proc->instructions.             */
+	size_t         capacity;         /*!< capacity of buff.                  */
+	addr_t         decoded;          /*!< position of first byte which
+	                                      isn't decoded.                     */
+	addr_t*        addrs;            /*!< positions of decoded instructions. */
+	size_t         code_capacity;    /*!< capacity of code and addrs.        */
+	size_t*        pending;          /*!< instructions with targets which
+	                                      aren't decoded yet.                */
+	size_t         pending_amount;   /*!< amount of such instructions.       */
+	size_t         pending_capacity; /*!< capacity of pending.               */
+}
+stream_t;
+
+/*!
+ * Options of processor's launch.
+ */
+typedef struct proc_options_t_
+{
+	engine_t    engine;          /*!< execution engine.                      */
+	bool        fusion;          /*!< replace frequent sequences of commands
+	                                  by superinstructions.                  */
+	size_t      stack_size;      /*!< capacity of operand stack.             */
+	size_t      call_stack_size; /*!< capacity of call stack.                */
+	bool        headless;        /*!< drw doesn't open window.               */
+	const char* capture;         /*!< drw writes frames to this file or
+	                                  directory instead of window or NULL.   */
+	bool        delta;           /*!< captured frames are differences
+	                                  between pictures.                      */
+	unsigned    fps;             /*!< max frame rate of window or 0.         */
+	bool        huge_pages;      /*!< back memory with huge pages.           */
+	bool        sandbox;         /*!< out-of-bounds memory accesses hit
+	                                  guard pages and stop the program.      */
+	bool        stream;          /*!< execute the image while it is being
+	                                  received (switch engine only).         */
+	bool        count;           /*!< print amount of executed instructions
+	                                  (switch engine only).                  */
+	bool        binary_io;       /*!< in and out use 4-byte little-endian
+	                                  frames instead of text.                */
+}
+proc_options_t;
+
 /*!
  * State of processor.
  */
 typedef struct proc_state_t_
 {
-	processor_value_t mem[MEMORY_SIZE];  /*!< memory. First VIDEO_MEM_SIZE 
-	                                          bytes are video memory.        */
+	processor_value_t* mem;              /*!< memory. First VIDEO_MEM_SIZE 
+	                                          bytes are video memory. It is
+	                                          anonymous mapping which is
+	                                          committed lazily.              */
+	size_t            mem_bytes;         /*!< size of mapping with memory.   */
+	bool              sandbox;           /*!< memory is followed by guard
+	                                          pages up to SANDBOX_SIZE.      */
+	void*             native;            /*!< native code of JIT engine.     */
+	size_t            native_size;       /*!< size of native code.           */
 	processor_value_t regs[REGS_NUMBER]; /*!< registers.                     */
-	addr_t            ip;                /*!< instruction pointer.           */
-	unsigned char*    instructions;      /*!< array with instructions.       */
+	addr_t            ip;                /*!< instruction pointer. It is an
+	                                          index in proc->code after
+	                                          decoding.                      */
+	const unsigned char* instructions;   /*!< array with instructions.       */
 	size_t            instr_size;        /*!< size of array with 
 	                                          instructions.                  */
+	bool              instr_mapped;      /*!< instructions are mapped
+	                                          from input file.               */
+	stream_t*         stream;            /*!< streaming loader or NULL.      */
+	instr_t*          code;              /*!< decoded instructions.          */
+	size_t            code_size;         /*!< amount of decoded 
+	                                          instructions.                  */
+#ifdef DEBUGGER
 	stack_t           stack;             /*!< stack.                         */
 	stack_t           address_stack;     /*!< stack with addresses 
 	                                          of points of return.           */
+#else
+	value_stack_t     stack;             /*!< stack.                         */
+	call_stack_t      address_stack;     /*!< stack with addresses 
+	                                          of points of return.           */
+#endif // defined DEBUGGER
+	bool              stack_checks;      /*!< engines check bounds of
+	                                          operand stack.                 */
+	bool              headless;          /*!< drw doesn't open window.       */
+	unsigned long long executed;         /*!< amount of instructions executed
+	                                          by switch engine.              */
 	proc_error_t      error;             /*!< error code that occures
 	                                          during the execution.          */
-	SDL_Window*       window;            /*!< window.                        */
-	SDL_Renderer*     renderer;          /*!< renderer of window.            */
+	proc_io_t         io;                /*!< buffers of in and out.         */
+	capture_t*        capture;           /*!< capture of frames or NULL.     */
+	unsigned char     dirty_rows[VIDEO_HEIGHT]; /*!< rows of video memory
+	                                          which are written after
+	                                          the last drw.                  */
+	render_t*         render;            /*!< render thread with window
+	                                          or NULL before the first drw.  */
+	unsigned          fps;               /*!< max frame rate of window
+	                                          or 0.                          */
 }
 *proc_state_t;
 
@@ -102,7 +313,8 @@ bool debugger_process
  */
 proc_error_t run 
 (
-	FILE* input /*!< [in] input compiled file.                               */
+	FILE*                 input,  /*!< [in] input compiled file.             */
+	const proc_options_t* options /*!< [in] launch options.                  */
 );
 
 /*!
@@ -112,7 +324,8 @@ proc_error_t run
  */
 proc_state_t proc_init
 (
-	FILE* input /*!< [in] input file with instructions.                      */
+	FILE*                 input,  /*!< [in] input file with instructions.    */
+	const proc_options_t* options /*!< [in] launch options.                  */
 );
 
 /*!
@@ -135,6 +348,58 @@ proc_state_t proc_delete
 	proc_state_t proc /*!< [in] processor state.                             */
 );
 
+/*!
+ * Execute decoded program until it stops.
+ *
+ * If memory is sandboxed, access to guard pages stops the program
+ * with MEM_FAULT.
+ */
+void proc_run
+(
+	proc_state_t proc,  /*!< [in,out] processor state.                       */
+	engine_t     engine /*!< [in]     execution engine.                      */
+);
+
+/*!
+ * Execute decoded program using direct-threaded code.
+ *
+ * Every handler jumps straight to the handler of next instruction.
+ * Operand stack bounds aren't checked if proc->stack_checks is false.
+ *
+ * @return 0 when processor stops.
+ */
+int proc_run_threaded
+(
+	proc_state_t proc /*!< [in,out] processor state.                         */
+);
+
+/*!
+ * Execute decoded program using direct-threaded code with
+ * up to two top values of operand stack cached in local variables.
+ *
+ * Cached values are spilled to proc->stack when processor stops.
+ * Operand stack bounds aren't checked if proc->stack_checks is false.
+ *
+ * @return 0 when processor stops.
+ */
+int proc_run_cached
+(
+	proc_state_t proc /*!< [in,out] processor state.                         */
+);
+
+/*!
+ * Check operand stack depth of decoded program statically.
+ *
+ * If the stack can't underflow and its depth is bounded, the stack is
+ * resized to the max depth and proc->stack_checks is turned off.
+ *
+ * @return success of this operation.
+ */
+int check_stack_depth
+(
+	proc_state_t proc /*!< [in,out] processor state.                         */
+);
+
 /*!
  * Process next instruction.
  *
@@ -145,49 +410,135 @@ int proc_process
 	proc_state_t proc /*!< [in] processor state.                             */
 );
 
+/*!
+ * Check the whole image once before decoding.
+ *
+ * Every opcode must be known, every argument must lie inside the image,
+ * register indices must be less than REGS_NUMBER, constant addresses
+ * must be inside processor's memory and every jump or call target
+ * must be a beginning of instruction.
+ *
+ * @return correctness of the image.
+ */
+int verify_program
+(
+	proc_state_t proc /*!< [in,out] processor state.                         */
+);
+
+/*!
+ * Decode all instructions from the image into proc->code array.
+ *
+ * @note the image must be checked by verify_program(), so arguments
+ *       are read without bounds checks.
+ *
+ * @return success of this operation.
+ */
+int decode_program
+(
+	proc_state_t proc /*!< [in,out] processor state.                         */
+);
+
+/*!
+ * Receive next part of the image in streaming mode, then verify
+ * and decode instructions which are received completely.
+ *
+ * Instruction is decoded when MAX_INSTR_SIZE bytes after its beginning
+ * are received or the image ends. Targets which aren't decoded yet
+ * are marked by PENDING_TARGET until the decoder reaches them.
+ *
+ * @return success of this operation.
+ */
+int stream_fill
+(
+	proc_state_t proc /*!< [in,out] processor state.                         */
+);
+
+/*!
+ * Wait until instruction at proc->ip is decoded. Pending target
+ * in proc->ip is replaced by index of instruction.
+ *
+ * @return 1 if instruction can be executed, 0 if program ends there.
+ */
+int stream_reach
+(
+	proc_state_t proc /*!< [in,out] processor state.                         */
+);
+
+/*!
+ * Check signature and execute the image by switch engine
+ * while it is being received.
+ */
+void stream_run
+(
+	proc_state_t proc /*!< [in,out] processor state.                         */
+);
+
+/*!
+ * Replace frequent sequences of decoded commands by superinstructions.
+ *
+ * Sequences which contain jump targets or return points
+ * after their first command are not replaced.
+ *
+ * @return success of this operation.
+ */
+int fuse_instructions
+(
+	proc_state_t proc /*!< [in,out] processor state.                         */
+);
+
+/*!
+ * This function decodes one instruction and moves position in the image.
+ *
+ * @return correctness of instruction.
+ */
+int decode_instruction
+(
+	proc_state_t proc,    /*!< [in]     processor state.                     */
+	addr_t*      pos,     /*!< [in,out] position in the image.               */
+	instr_t*     decoded  /*!< [out]    decoded instruction.                 */
+);
+
 /*!
  * This function gets instruction's argument and moves
- * instruction pointer.
+ * position in the image.
  *
  * @return correctness of argument.
  */
 int get_arg
 (
-	proc_state_t        proc,     /*!< [in,out] processor state.             */
-	char                instr,    /*!< [in]     instruction number.          */
-	arg_t               arg_type, /*!< [in]     argument type.               */
-	addr_t*             addr,     /*!< [out]    pointer to value which will be
-	                                            assigned read address.       */
-	processor_value_t** val_ptr,  /*!< [out]    pointer to value which will be 
-	                                           assigned read value's address.        */
-	processor_value_t*  val       /*!< [out]    pointer to value which will be 
-	                                           assigned read value.          */
+	proc_state_t  proc,     /*!< [in]     processor state.                   */
+	addr_t*       pos,      /*!< [in,out] position in the image.             */
+	unsigned char instr,    /*!< [in]     instruction number.                */
+	arg_t         arg_type, /*!< [in]     argument type.                     */
+	instr_t*      decoded   /*!< [out]    decoded instruction.               */
 );
 
 /*!
- * Get address as label type argument and move instruction pointer.
+ * Get address as label type argument and move position in the image.
+ *
+ * @note decoded->target is assigned the address in the image. It is
+ *       replaced by instruction index in decode_program().
  *
  * @return success of this operation.
  */
 int get_label_arg 
 (
-	proc_state_t proc, /*!< [in,out] processor state.                        */
-	addr_t*      addr  /*!< [out]    value which will be assigned address.   */
+	proc_state_t proc,   /*!< [in]     processor state.                      */
+	addr_t*      pos,    /*!< [in,out] position in the image.                */
+	instr_t*     decoded /*!< [out]    decoded instruction.                  */
 );
 
 /*!
- * This function gets memory argument and moves the instruction pointer.
+ * This function gets memory argument and moves position in the image.
  *
  * @return correctness of argument.
  */
 int get_mem_arg
 (
-	proc_state_t        proc,    /*!< [in,out] processor state.              */
-	char                instr,   /*!< [in]     instruction number.           */
-	processor_value_t** val_ptr, /*!< [out]    pointer to value which will be 
-	                                           assigned read address.        */
-	processor_value_t*  val      /*!< [out]    pointer to value which will be 
-	                                           assigned read value.          */
+	proc_state_t  proc,   /*!< [in]     processor state.                     */
+	addr_t*       pos,    /*!< [in,out] position in the image.               */
+	unsigned char instr,  /*!< [in]     instruction number.                  */
+	instr_t*      decoded /*!< [out]    decoded instruction.                 */
 );
 
 /*!
@@ -0,0 +1,298 @@
+/*!
+ * @file
+ * @brief Window rendering in a separate thread.
+ *
+ * drw only converts rows of video memory which changed into a free slot
+ * of triple buffer, so the processor doesn't wait for SDL_RenderPresent()
+ * which may block on vsync. The render thread always takes the latest
+ * published picture, so pictures which are published faster than they
+ * can be presented are skipped.
+ */
+
+#define _DEFAULT_SOURCE
+
+
+
+/*============================ Including headers ============================*/
+
+
+#include "render.h"
+#include "../libs/others.h"
+#include "../libs/logging.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+
+
+
+/*======================== Macros & static functions ========================*/
+
+
+static uint64_t now_ns (void)
+{
+	struct timespec now = {};
+	clock_gettime(CLOCK_MONOTONIC, &now);
+
+	return (uint64_t) now.tv_sec * NS_PER_SEC + (uint64_t) now.tv_nsec;
+}
+
+
+/*
+ * Upload runs of rows which are marked in rows from pixels to texture.
+ */
+static void upload_rows (SDL_Texture* texture, const Uint32* pixels,
+                         const unsigned char* rows)
+{
+	addr_t begin = 0;
+	while (begin < VIDEO_HEIGHT)
+	{
+		if (!rows[begin])
+		{
+			++begin;
+			continue;
+		}
+
+		addr_t end = begin + 1;
+		while (end < VIDEO_HEIGHT && rows[end])
+			++end;
+
+		SDL_Rect rect = { 0, (int) begin, (int) VIDEO_WIDTH,
+		                  (int) (end - begin) };
+		SDL_UpdateTexture(texture, &rect, pixels + begin * VIDEO_WIDTH,
+		                  VIDEO_WIDTH * sizeof (Uint32));
+		begin = end;
+	}
+}
+
+
+static int render_loop (void* arg)
+{
+	render_t* render = (render_t*) arg;
+
+	SDL_Window*   window   = NULL;
+	SDL_Renderer* renderer = NULL;
+	SDL_Texture*  texture  = NULL;
+
+	SDL_Init(SDL_INIT_EVERYTHING);
+	SDL_CreateWindowAndRenderer(VIDEO_WIDTH, VIDEO_HEIGHT, 0,
+	                            &window, &renderer);
+	if (window)
+		texture = SDL_CreateTexture(renderer, SDL_PIXELFORMAT_ARGB8888,
+		                            SDL_TEXTUREACCESS_STREAMING,
+		                            VIDEO_WIDTH, VIDEO_HEIGHT);
+
+	unsigned char upload[VIDEO_HEIGHT];
+
+	SDL_LockMutex(render->mutex);
+	while (true)
+	{
+		while (!render->fresh && !render->finish)
+			SDL_CondWait(render->cond, render->mutex);
+
+		if (!render->fresh)
+			break;
+
+		size_t read   = render->ready;
+		render->ready = render->read;
+		render->read  = read;
+		render->fresh = false;
+
+		memcpy(upload, render->upload, sizeof upload);
+		memset(render->upload, 0, sizeof render->upload);
+		SDL_UnlockMutex(render->mutex);
+
+		/* processor doesn't touch read slot, so it isn't locked          */
+		if (texture)
+		{
+			upload_rows(texture, render->slots[read], upload);
+			SDL_RenderCopy(renderer, texture, NULL, NULL);
+			SDL_RenderPresent(renderer);
+		}
+
+		SDL_LockMutex(render->mutex);
+		++render->presented;
+	}
+	SDL_UnlockMutex(render->mutex);
+
+	if (window)
+	{
+		SDL_Event event;
+		while (!(SDL_PollEvent(&event) && event.type == SDL_QUIT))
+			continue;
+
+		if (texture)
+			SDL_DestroyTexture(texture);
+
+		SDL_DestroyRenderer(renderer);
+		SDL_DestroyWindow(window);
+	}
+
+	SDL_Quit();
+	return 0;
+}
+
+
+static void render_free (render_t* render)
+{
+	for (size_t i = 0; i < RENDER_SLOTS; ++i)
+		free(render->slots[i]);
+
+	if (render->cond)
+		SDL_DestroyCond(render->cond);
+
+	if (render->mutex)
+		SDL_DestroyMutex(render->mutex);
+
+	free(render);
+}
+
+
+/*
+ * Convert stale rows of write slot and make it the ready one.
+ */
+static void publish (render_t* render, const processor_value_t* video,
+                     const unsigned char* dirty_rows)
+{
+	for (size_t slot = 0; slot < RENDER_SLOTS; ++slot)
+		for (addr_t y = 0; y < VIDEO_HEIGHT; ++y)
+			render->stale[slot][y] |= dirty_rows[y];
+
+	/* write slot belongs to the processor, so it is filled unlocked     */
+	Uint32*        pixels = render->slots[render->write];
+	unsigned char* stale  = render->stale[render->write];
+	for (addr_t y = 0; y < VIDEO_HEIGHT; ++y)
+	{
+		if (!stale[y])
+			continue;
+
+		/* video memory is row-major: cell y * VIDEO_WIDTH + x is (x, y) */
+		for (addr_t i = y * VIDEO_WIDTH; i < (y + 1) * VIDEO_WIDTH; ++i)
+			pixels[i] = video[i] ? VIDEO_WHITE : VIDEO_BLACK;
+
+		stale[y] = 0;
+	}
+
+	SDL_LockMutex(render->mutex);
+
+	size_t ready   = render->ready;
+	render->ready  = render->write;
+	render->write  = ready;
+	render->fresh  = true;
+
+	for (addr_t y = 0; y < VIDEO_HEIGHT; ++y)
+		render->upload[y] |= dirty_rows[y];
+
+	SDL_CondSignal(render->cond);
+	SDL_UnlockMutex(render->mutex);
+}
+
+
+
+
+/*========================= Functions implementation ========================*/
+
+
+render_t* render_start (unsigned fps)
+{
+	render_t* render = (render_t*) calloc(1, sizeof *render);
+	if (!render)
+		return NULL;
+
+	for (size_t i = 0; i < RENDER_SLOTS; ++i)
+	{
+		render->slots[i] = (Uint32*) malloc(VIDEO_MEM_SIZE * sizeof (Uint32));
+		if (!render->slots[i])
+		{
+			render_free(render);
+			return NULL;
+		}
+	}
+
+	/* every slot has to be converted completely before the first use    */
+	memset(render->stale, 1, sizeof render->stale);
+	render->write    = 0;
+	render->ready    = 1;
+	render->read     = 2;
+	render->interval = fps ? NS_PER_SEC / fps : 0;
+
+	render->mutex = SDL_CreateMutex();
+	render->cond  = SDL_CreateCond();
+	if (!render->mutex || !render->cond)
+	{
+		render_free(render);
+		return NULL;
+	}
+
+	render->thread = SDL_CreateThread(render_loop, "render", render);
+	if (!render->thread)
+	{
+		render_free(render);
+		return NULL;
+	}
+
+	return render;
+}
+
+
+bool render_publish (render_t* render, const processor_value_t* video,
+                     const unsigned char* dirty_rows)
+{
+	if_log (is_bad_mem(render, sizeof *render), ERROR,
+		return false;)
+
+	if_log (is_bad_mem(video, VIDEO_MEM_SIZE * sizeof *video), ERROR,
+		return false;)
+
+	if_log (is_bad_mem(dirty_rows, VIDEO_HEIGHT), ERROR,
+		return false;)
+
+	++render->draws;
+
+	/* the first picture is always published                             */
+	uint64_t now = render->interval ? now_ns() : 0;
+	if (render->interval && render->draws > 1
+	    && now - render->published_at < render->interval)
+	{
+		render->pending = true;
+		return false;
+	}
+
+	publish(render, video, dirty_rows);
+	render->published_at = now;
+	render->pending      = false;
+	return true;
+}
+
+
+void render_stop (render_t* render, const processor_value_t* video,
+                  const unsigned char* dirty_rows, FILE* report)
+{
+	if_log (is_bad_mem(render, sizeof *render), ERROR,
+		return;)
+
+	if_log (is_bad_mem(video, VIDEO_MEM_SIZE * sizeof *video), ERROR,
+		return;)
+
+	if_log (is_bad_mem(dirty_rows, VIDEO_HEIGHT), ERROR,
+		return;)
+
+	/* the latest state is shown even if its drw was coalesced           */
+	if (render->pending)
+		publish(render, video, dirty_rows);
+
+	SDL_LockMutex(render->mutex);
+	render->finish = true;
+	SDL_CondSignal(render->cond);
+	SDL_UnlockMutex(render->mutex);
+
+	SDL_WaitThread(render->thread, NULL);
+
+	if (report)
+		fprintf(report, "Frames: %llu drawn, %llu presented, %llu coalesced\n",
+		        render->draws, render->presented,
+		        render->draws - render->presented);
+
+	render_free(render);
+}
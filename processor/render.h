@@ -0,0 +1,138 @@
+/*!
+ * @file
+ * @brief Header for window rendering in a separate thread.
+ */
+
+#ifndef RENDER_H_
+#define RENDER_H_
+
+
+
+
+/*============================ Including headers ============================*/
+
+
+#include "../commands.h"
+
+#include <stdio.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <SDL2/SDL.h>
+
+
+
+
+/*=========================== Constants declaration =========================*/
+
+/*!
+ * Colors of video memory cells in ARGB8888: zero cell is black,
+ * other cells are white.
+ */
+#define VIDEO_BLACK (Uint32) 0xFF000000
+#define VIDEO_WHITE (Uint32) 0xFFFFFFFF
+
+/*!
+ * Amount of pictures in buffer between processor and render thread:
+ * one is written, one is presented and one is the latest published.
+ */
+#define RENDER_SLOTS (size_t) 3
+
+/*!
+ * Nanoseconds in second.
+ */
+#define NS_PER_SEC (uint64_t) 1000000000
+
+
+
+
+/*============================ Types declaration ============================*/
+
+/*!
+ * Triple buffer of pictures and render thread which presents them.
+ *
+ * The render thread owns the window: it initialises SDL, presents
+ * the latest published picture and destroys the window after it is
+ * closed. Slot indices, fresh, upload, finish and presented are guarded
+ * by mutex.
+ */
+typedef struct render_t_
+{
+	SDL_Thread*   thread;                   /*!< render thread.              */
+	SDL_mutex*    mutex;                    /*!< mutex of shared fields.     */
+	SDL_cond*     cond;                     /*!< signalled on new picture
+	                                             and on finish.              */
+	Uint32*       slots[RENDER_SLOTS];      /*!< pictures in ARGB8888.       */
+	unsigned char stale[RENDER_SLOTS][VIDEO_HEIGHT]; /*!< rows of slot which
+	                                             are older than video
+	                                             memory.                     */
+	size_t        write;                    /*!< slot written by processor.  */
+	size_t        ready;                    /*!< the latest published slot.  */
+	size_t        read;                     /*!< slot presented by thread.   */
+	bool          fresh;                    /*!< ready slot isn't presented
+	                                             yet.                        */
+	unsigned char upload[VIDEO_HEIGHT];     /*!< rows changed after
+	                                             the presented picture.      */
+	bool          finish;                   /*!< processor has stopped.      */
+	uint64_t      interval;                 /*!< min time between published
+	                                             pictures in ns or 0.        */
+	uint64_t      published_at;             /*!< time of the last
+	                                             publication in ns.          */
+	bool          pending;                  /*!< the last drw isn't
+	                                             published.                  */
+	unsigned long long draws;               /*!< amount of drw.              */
+	unsigned long long presented;           /*!< amount of presented
+	                                             pictures.                   */
+}
+render_t;
+
+
+
+
+/*========================== Functions declaration ==========================*/
+
+/*!
+ * Start render thread. Window is opened by the thread.
+ *
+ * @return render state which must be stopped by render_stop()
+ *         or NULL if thread can't be started.
+ */
+render_t* render_start
+(
+	unsigned fps /*!< [in] max frame rate or 0 if it is unlimited.           */
+);
+
+/*!
+ * Convert video memory into a free slot and publish it.
+ * It doesn't wait for the picture to be presented.
+ *
+ * If the previous picture is published less than a frame interval ago,
+ * nothing is done: the picture is coalesced with the next drw.
+ *
+ * @return true if picture is published, so dirty rows are consumed.
+ */
+bool render_publish
+(
+	render_t*                render,    /*!< [in,out] render state.          */
+	const processor_value_t* video,     /*!< [in]     video memory.          */
+	const unsigned char*     dirty_rows /*!< [in]     rows written after
+	                                                  the last publication.  */
+);
+
+/*!
+ * Publish coalesced picture, let the thread present the last picture,
+ * wait until the window is closed and free render state.
+ */
+void render_stop
+(
+	render_t*                render,     /*!< [in] render state.             */
+	const processor_value_t* video,      /*!< [in] video memory.             */
+	const unsigned char*     dirty_rows, /*!< [in] rows written after
+	                                               the last publication.     */
+	FILE*                    report      /*!< [in] stream for amounts of
+	                                               frames or NULL.           */
+);
+
+
+
+
+#endif // ifndef RENDER_H_
@@ -0,0 +1,93 @@
+/*!
+ * @file
+ * @brief Catching faults of sandboxed memory accesses.
+ *
+ * SIGSEGV and SIGBUS handler checks that the faulting address belongs
+ * to the region of sandbox which runs in the current thread and jumps
+ * back to sandbox_call(). Other faults are restarted with default action.
+ */
+
+#define _DEFAULT_SOURCE
+
+
+
+/*============================ Including headers ============================*/
+
+
+#include "sandbox.h"
+
+#include <stdbool.h>
+#include <signal.h>
+#include <setjmp.h>
+
+
+
+
+/*======================== Macros & static functions ========================*/
+
+
+/*
+ * Sandbox which runs in this thread.
+ */
+static _Thread_local sigjmp_buf*  fault_env   = NULL;
+static _Thread_local const char*  fault_begin = NULL;
+static _Thread_local const char*  fault_end   = NULL;
+static _Thread_local const void*  fault_addr  = NULL;
+
+
+static void fault_handler (int sig, siginfo_t* info, void* context)
+{
+	(void) context;
+
+	const char* addr = (const char*) info->si_addr;
+	if (fault_env && addr >= fault_begin && addr < fault_end)
+	{
+		fault_addr = addr;
+		siglongjmp(*fault_env, 1);
+	}
+
+	signal(sig, SIG_DFL);
+}
+
+
+static bool install_handler (void)
+{
+	struct sigaction action = {};
+	action.sa_sigaction = fault_handler;
+	action.sa_flags     = SA_SIGINFO;
+	sigemptyset(&action.sa_mask);
+
+	return sigaction(SIGSEGV, &action, NULL) == 0
+	       && sigaction(SIGBUS, &action, NULL) == 0;
+}
+
+
+
+
+/*========================= Functions implementation ========================*/
+
+
+sandbox_status_t sandbox_call (void (*func)(void*), void* arg,
+                               const void* begin, const void* end,
+                               const void** fault)
+{
+	if (!install_handler())
+		return SANDBOX_NO_HANDLER;
+
+	sigjmp_buf env;
+	if (sigsetjmp(env, 1))
+	{
+		fault_env = NULL;
+		*fault    = fault_addr;
+		return SANDBOX_FAULT;
+	}
+
+	fault_begin = (const char*) begin;
+	fault_end   = (const char*) end;
+	fault_env   = &env;
+
+	func(arg);
+
+	fault_env = NULL;
+	return SANDBOX_OK;
+}
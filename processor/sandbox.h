@@ -0,0 +1,60 @@
+/*!
+ * @file
+ * @brief Header for catching faults of sandboxed memory accesses.
+ *
+ * It doesn't include processor.h because signal.h declares stack_t
+ * which conflicts with the one from secure_stack.h.
+ */
+
+#ifndef SANDBOX_H_
+#define SANDBOX_H_
+
+
+
+
+/*============================ Including headers ============================*/
+
+
+#include <stddef.h>
+
+
+
+
+/*============================ Types declaration ============================*/
+
+/*!
+ * Result of sandbox_call().
+ */
+typedef enum sandbox_status_t_
+{
+	SANDBOX_OK         = 0, /*!< function returned.                          */
+	SANDBOX_FAULT      = 1, /*!< function accessed guarded region.           */
+	SANDBOX_NO_HANDLER = 2  /*!< signal handler can't be installed.          */
+}
+sandbox_status_t;
+
+
+
+
+/*========================== Functions declaration ==========================*/
+
+/*!
+ * Call function and stop it if it accesses inaccessible page of region.
+ *
+ * Faults outside of the region keep default behaviour. Function is
+ * left by siglongjmp(), so it mustn't hold resources which are freed
+ * only on return.
+ */
+sandbox_status_t sandbox_call
+(
+	void      (*func)(void*), /*!< [in]  called function.                    */
+	void*       arg,          /*!< [in]  argument of function.               */
+	const void* begin,        /*!< [in]  beginning of region.                */
+	const void* end,          /*!< [in]  end of region.                      */
+	const void** fault        /*!< [out] faulting address.                   */
+);
+
+
+
+
+#endif // ifndef SANDBOX_H_
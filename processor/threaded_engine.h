@@ -0,0 +1,145 @@
+/*!
+ * @file
+ * @brief Template of direct-threaded engine.
+ *
+ * processor.c includes this file once for every variant of the engine.
+ * Before including it defines:
+ *
+ *  ENGINE_NAME_   - name of generated static function;
+ *  ENGINE_CACHED_ - keep top of operand stack in local variables;
+ *  ENGINE_CHECKS_ - check bounds of operand stack.
+ *
+ * PUSH, POP and TOP are defined there through cache_push(), cache_pop()
+ * and cache_top() with these parameters. Every handler jumps straight
+ * to the handler of next instruction.
+ *
+ * Generated function returns 1 if it stopped because STACK_UNPROVEN
+ * happened in engine without stack checks, so the execution has to be
+ * continued with checks. Otherwise it returns 0.
+ */
+
+#ifdef ENGINE_NAME_
+
+
+
+
+#define HANDLERS_NO_ARGS(NAME_, NUM_)                                         \
+	[NUM_] = &&do_##NAME_,
+
+#define HANDLERS_LABEL_ARG(NAME_, NUM_)                                       \
+	[NUM_] = &&do_##NAME_,
+
+#define HANDLER_ENTRY_(LABEL_, OPCODE_, ...)                                  \
+	[OPCODE_] = &&do_##LABEL_,
+
+#define HANDLERS_MEMORY_ARG(NAME_, NUM_)                                      \
+	FOR_EACH_MODE_(HANDLER_ENTRY_, NAME_, NUM_, )
+
+#define DEF_CMD(NAME_, NUM_, ARGS_, ...)                                      \
+	HANDLERS_##ARGS_(NAME_, NUM_)
+
+#define DEF_FUSED(NAME_, NUM_, ...)                                           \
+	[NUM_] = &&fused_##NAME_,
+
+#define DISPATCH_                                                             \
+{                                                                             \
+	instr = proc->code + proc->ip++;                                          \
+	goto *instr->handler;                                                     \
+}
+
+static int ENGINE_NAME_ (proc_state_t proc)
+{
+	static const void* const HANDLERS[UCHAR_MAX + 1] =
+	{
+		#include "../DEF_CMD"   // e.g. [13] = &&do_add, [75] = &&do_push_reg,
+		#include "../DEF_FUSED" // e.g. [32] = &&fused_add_rc_pop,
+	};
+
+	/* hit returns from the engine, so it is handled by end_of_code
+	 * which spills the cache before that                                */
+	for (size_t i = 0; i < proc->code_size; ++i)
+		proc->code[i].handler = (proc->code[i].cmd == cmd_hit)
+		                      ? &&end_of_code
+		                      : HANDLERS[proc->code[i].cmd | proc->code[i].mode];
+
+	proc->code[proc->code_size].handler = &&end_of_code;
+
+	tos_cache_t        cache = { .size = 0 };
+	const instr_t*     instr;
+	processor_value_t* VAL_PTR;
+	processor_value_t  VAL;
+	addr_t             ADDR;
+
+	DISPATCH_;
+
+#undef DEF_CMD
+#undef DEF_FUSED
+
+#define HANDLER_NO_ARGS(NAME_, NUM_, CODE_)                                   \
+	do_##NAME_:                                                               \
+		CODE_;                                                                \
+		DISPATCH_;
+
+#define HANDLER_LABEL_ARG(NAME_, NUM_, CODE_)                                 \
+	do_##NAME_:                                                               \
+		ADDR = instr->target;                                                 \
+		CODE_;                                                                \
+		if (proc->error != NO_PROC_ERR)                                       \
+			proc->ip = proc->code_size;                                       \
+		DISPATCH_;
+
+#define HANDLER_MODE_(LABEL_, OPCODE_, MODE_, CODE_)                          \
+	do_##LABEL_:                                                              \
+	{                                                                         \
+		enum { MODE = MODE_ };                                                \
+		load_mem_arg(proc, instr, MODE, &VAL_PTR, &VAL);                      \
+		CODE_;                                                                \
+		DISPATCH_;                                                            \
+	}
+
+#define HANDLER_MEMORY_ARG(NAME_, NUM_, CODE_)                                \
+	FOR_EACH_MODE_(HANDLER_MODE_, NAME_, NUM_, CODE_)
+
+#define DEF_CMD(NAME_, NUM_, ARGS_, CODE_)                                    \
+	HANDLER_##ARGS_(NAME_, NUM_, CODE_)
+
+#define DEF_FUSED(NAME_, NUM_, CODE_)                                         \
+	fused_##NAME_:                                                            \
+		proc->ip += instr->len - 1;                                           \
+		ADDR      = instr->target;                                            \
+		CODE_;                                                                \
+		DISPATCH_;
+
+	#include "../DEF_CMD"
+	#include "../DEF_FUSED"
+
+end_of_code:
+	cache_spill(proc, &cache);
+	return 0;
+
+stack_unproven:
+	cache_spill(proc, &cache);
+	proc->stack_checks = true;
+	return 1;
+}
+
+#undef DEF_CMD
+#undef DEF_FUSED
+#undef DISPATCH_
+#undef HANDLERS_NO_ARGS
+#undef HANDLERS_LABEL_ARG
+#undef HANDLERS_MEMORY_ARG
+#undef HANDLER_ENTRY_
+#undef HANDLER_NO_ARGS
+#undef HANDLER_LABEL_ARG
+#undef HANDLER_MEMORY_ARG
+#undef HANDLER_MODE_
+
+#undef ENGINE_NAME_
+#undef ENGINE_CACHED_
+#undef ENGINE_CHECKS_
+
+
+
+
+#endif // defined ENGINE_NAME_